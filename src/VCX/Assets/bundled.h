@@ -18,6 +18,9 @@ namespace VCX::Assets {
         })
     };
 
+    // tileable 256x256 blue noise, one channel.
+    inline constexpr std::string_view BlueNoiseImage { "assets/images/bluenoise-256x256.png" };
+
     inline constexpr auto ExampleModels {
         std::to_array<std::string_view>({
             "assets/models/arma.obj",
@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "Engine/Async.hpp"
+
+namespace VCX::Engine {
+    AsyncExecutor & AsyncExecutor::Get() {
+        static AsyncExecutor executor;
+        return executor;
+    }
+
+    AsyncExecutor::AsyncExecutor() {
+        // the tasks are long-running loops that hand their heavy work to a ThreadPool sized to the machine and mostly
+        // wait on it, e.g. one render loop on screen and one benchmark; more threads would only oversubscribe the cores.
+        constexpr std::size_t numThreads = 2;
+        for (std::size_t i = 0; i < numThreads; ++i)
+            _workers.emplace_back([this]() { Run(); });
+    }
+
+    AsyncExecutor::~AsyncExecutor() {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto & worker : _workers) worker.join();
+    }
+
+    void AsyncExecutor::Submit(std::function<void()> task, AsyncPriority const priority) {
+        {
+            std::lock_guard lock(_mutex);
+            _queues[std::size_t(priority)].push_back(std::move(task));
+        }
+        _wake.notify_one();
+    }
+
+    void AsyncExecutor::Run() {
+        std::unique_lock lock(_mutex);
+        while (true) {
+            auto const queue = std::find_if(_queues.rbegin(), _queues.rend(), [](auto const & q) { return ! q.empty(); });
+            if (queue == _queues.rend()) {
+                // queued tasks still run on exit, their owners may be waiting for them.
+                if (_stop) return;
+                _wake.wait(lock);
+                continue;
+            }
+            std::function<void()> task = std::move(queue->front());
+            queue->pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+}
@@ -1,67 +1,230 @@
 #pragma once
 
-#include <any>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace VCX::Engine {
-    // an computationally expensive value that will be asynchronously evaluated.
+    enum class AsyncPriority {
+        Low,
+        Normal,
+        High,
+    };
+
+    // shared flag through which a queued or running task is asked to stop. a queued task is dropped,
+    // a running one stops only if it polls the token.
+    class CancellationToken {
+    public:
+        CancellationToken() : _cancelled(std::make_shared<std::atomic<bool>>(false)) { }
+
+        void Cancel() const { _cancelled->store(true); }
+        bool IsCancelled() const { return _cancelled->load(); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> _cancelled;
+    };
+
+    // process-wide workers behind every Async, a fixed pair of them. the oldest task of the highest priority is taken
+    // first; tasks that run long should split their work onto a ThreadPool rather than compute on these threads.
+    class AsyncExecutor {
+    public:
+        static AsyncExecutor & Get();
+
+        void Submit(std::function<void()> task, AsyncPriority const priority);
+
+        std::size_t GetThreadCount() const { return _workers.size(); }
+
+    private:
+        AsyncExecutor();
+        ~AsyncExecutor();
+
+        void Run();
+
+        std::array<std::deque<std::function<void()>>, 3> _queues; // indexed by priority
+        std::vector<std::thread>                          _workers;
+        std::mutex                                        _mutex;
+        std::condition_variable                           _wake;
+        bool                                              _stop { false };
+    };
+
+    // an computationally expensive value that will be asynchronously evaluated on the AsyncExecutor.
     // the method names are intendedly aligned with std::optional<T>;
+    // Emplace(..) and Reset() cancel the previous task without waiting for it, only the destructor waits,
+    // and only if the current task is already running.
     template<typename T>
     class Async {
     public:
+        static_assert(! std::is_void_v<T>, "Async<void> has no value to wait for.");
+
+        using Func           = std::function<T()>;
+        using CancelableFunc = std::function<T(CancellationToken const &)>;
+
         Async() = default;
-        Async(std::function<T()> && func) { Emplace(func); }
+        Async(Func && func, AsyncPriority const priority = AsyncPriority::Normal) { Emplace(std::move(func), priority); }
+        Async(CancelableFunc && func, AsyncPriority const priority = AsyncPriority::Normal) { Emplace(std::move(func), priority); }
+
+        Async(Async && other) = default;
 
-        ~Async() { if (_thread.joinable()) _thread.join(); }
+        Async & operator=(Async && other) {
+            if (this != &other) {
+                Reset();
+                _state = std::move(other._state);
+            }
+            return *this;
+        }
+
+        ~Async() {
+            if (! _state) return;
+            _state->Token.Cancel();
+            if (! _state->Started) return;
+            std::unique_lock lock(_state->Mutex);
+            _state->Done.wait(lock, [&]() { return _state->Finished.load(); });
+        }
 
         void Reset() {
-          if (_thread.joinable()) _thread.join();
-          _completed = false;
+            if (_state) _state->Token.Cancel();
+            _state.reset();
+        }
+
+        void Emplace(Func && func, AsyncPriority const priority = AsyncPriority::Normal) {
+            Emplace(CancelableFunc([func = std::move(func)](CancellationToken const &) { return func(); }), priority);
+        }
+
+        void Emplace(CancelableFunc && func, AsyncPriority const priority = AsyncPriority::Normal) {
+            Reset();
+            _state = std::make_shared<State>();
+            Schedule(_state, std::move(func), priority);
+        }
+
+        void Cancel() {
+            if (_state) _state->Token.Cancel();
+        }
+
+        // runs func(value) once this one has a value; if it ends without one, so does the continuation.
+        template<typename F>
+        auto Then(F && func, AsyncPriority const priority = AsyncPriority::Normal) -> Async<std::invoke_result_t<F, T const &>> {
+            using U = std::invoke_result_t<F, T const &>;
+            Async<U> next;
+            next._state = std::make_shared<typename Async<U>::State>();
+            if (! _state) {
+                Async<U>::Finish(*next._state);
+                return next;
+            }
+            std::function<void()> proceed = [source = _state, target = next._state, func = std::forward<F>(func), priority]() {
+                if (! source->HasValue || target->Token.IsCancelled()) {
+                    target->Error = source->Error;
+                    Async<U>::Finish(*target);
+                    return;
+                }
+                Async<U>::Schedule(target, [source, func](CancellationToken const &) { return func(*source->Result); }, priority);
+            };
+            std::unique_lock lock(_state->Mutex);
+            if (_state->Finished) {
+                lock.unlock();
+                proceed();
+            } else _state->Continuations.push_back(std::move(proceed));
+            return next;
         }
 
-        void Emplace(std::function<T()> && func) {
-            if (_thread.joinable()) _thread.join();
-            _completed = false;
-            _thread = std::move(std::thread([
-                func        = std::move(func),
-                & completed = _completed,
-                & result    = _result]() {
-                result = func();
-                completed.store(true);
-            }));
+        // holds a task, finished or not, until Reset().
+        bool IsValid() const { return bool(_state); }
+
+        // blocks until the task finished, returns at once without one.
+        void Wait() const {
+            if (! _state) return;
+            std::unique_lock lock(_state->Mutex);
+            _state->Done.wait(lock, [&]() { return _state->Finished.load(); });
         }
 
-        bool HasValue() const { return _completed.load(); }
+        bool HasValue() const { return _state && _state->HasValue.load(); }
+
+        // finished with a value, an exception, or dropped after Cancel().
+        bool IsCompleted() const { return _state && _state->Finished.load(); }
+
+        bool IsCancelled() const { return _state && _state->Token.IsCancelled(); }
 
         T const & Value() const {
             if (HasValue())
-                return _result.value();
+                return _state->Result.value();
             else
                 throw std::runtime_error("result is not ready.");
         }
 
         T const & ValueOr(T const & alt) const {
             if (HasValue())
-                return _result.value();
+                return _state->Result.value();
             else
                 return alt;
         }
 
+        // rethrows what the task threw.
         T const & WaitForValue() {
-            if (_thread.joinable()) _thread.join();
-            return _result.value();
+            if (! _state) throw std::runtime_error("no task to wait for.");
+            std::unique_lock lock(_state->Mutex);
+            _state->Done.wait(lock, [&]() { return _state->Finished.load(); });
+            if (_state->Error) std::rethrow_exception(_state->Error);
+            if (! _state->Result) throw std::runtime_error("task was cancelled.");
+            return _state->Result.value();
+        }
+
+    private:
+        template<typename>
+        friend class Async;
+
+        struct State {
+            std::mutex                         Mutex;
+            std::condition_variable            Done;
+            std::optional<T>                   Result;
+            std::exception_ptr                 Error;
+            CancellationToken                  Token;
+            std::atomic<bool>                  Started { false };
+            std::atomic<bool>                  HasValue { false };
+            std::atomic<bool>                  Finished { false };
+            std::vector<std::function<void()>> Continuations; // run once Finished
+        };
+
+        static void Schedule(std::shared_ptr<State> const & state, CancelableFunc func, AsyncPriority const priority) {
+            AsyncExecutor::Get().Submit([state, func = std::move(func)]() {
+                // with Cancel() checking Started afterwards, either the task is dropped here or the destructor waits for it.
+                state->Started = true;
+                if (! state->Token.IsCancelled()) {
+                    try {
+                        auto value = func(state->Token);
+                        std::lock_guard lock(state->Mutex);
+                        state->Result.emplace(std::move(value));
+                    } catch (...) {
+                        std::lock_guard lock(state->Mutex);
+                        state->Error = std::current_exception();
+                    }
+                }
+                Finish(*state);
+            }, priority);
         }
 
-        bool IsCompleted() const {
-          return _completed.load();
+        static void Finish(State & state) {
+            std::vector<std::function<void()>> continuations;
+            {
+                std::lock_guard lock(state.Mutex);
+                state.HasValue = state.Result.has_value();
+                state.Finished = true;
+                continuations  = std::move(state.Continuations);
+            }
+            state.Done.notify_all();
+            for (auto const & proceed : continuations) proceed();
         }
 
-    private:
-        std::thread     _thread;
-        std::atomic_bool _completed = false;
-        std::optional<T> _result;
+        std::shared_ptr<State> _state;
     };
 }
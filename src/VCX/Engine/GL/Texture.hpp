@@ -2,6 +2,7 @@
 
 #include "Engine/GL/Sampler.hpp"
 #include "Engine/TextureND.hpp"
+#include "Engine/Trace.h"
 
 namespace VCX::Engine::GL {
     template<TextureFormat Format> inline constexpr GLenum InternalFormatEnumOf = 0;
@@ -115,7 +116,8 @@ namespace VCX::Engine::GL {
 
         template<typename Content>
         void Update(Content const & texture) const {
-            auto const useThis { Use() };
+            TraceScope const trace("UploadTexture", "upload");
+            auto const       useThis { Use() };
             glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             UpdateImpl(texture);
             glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
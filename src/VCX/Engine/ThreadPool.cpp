@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include "Engine/ThreadPool.h"
+
+namespace VCX::Engine {
+    namespace {
+        thread_local ThreadPool const * t_Pool        = nullptr;
+        thread_local std::size_t        t_WorkerIndex = 0;
+    }
+
+    ThreadPool::ThreadPool(std::size_t const numThreads) {
+        std::size_t const count = numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+        for (std::size_t i = 0; i < count; ++i) _queues.push_back(std::make_unique<Queue>());
+        for (std::size_t i = 0; i < count; ++i) _workers.emplace_back([this, i]() { Run(i); });
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto & worker : _workers) worker.join();
+    }
+
+    void ThreadPool::Submit(std::function<void()> task) {
+        bool const        nested = t_Pool == this;
+        std::size_t const index  = nested ? t_WorkerIndex : _next.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+        {
+            std::lock_guard lock(_queues[index]->Mutex);
+            (nested ? _queues[index]->Nested : _queues[index]->Shared).push_back(std::move(task));
+        }
+        _pending.fetch_add(1);
+        // taking the lock orders this notification after a worker's check of _pending, so it cannot be lost.
+        { std::lock_guard lock(_mutex); }
+        _wake.notify_one();
+    }
+
+    std::size_t ThreadPool::GetWorkerIndex() const {
+        return t_Pool == this ? t_WorkerIndex : _workers.size();
+    }
+
+    static bool PopFront(std::deque<std::function<void()>> & tasks, std::function<void()> & task) {
+        if (tasks.empty()) return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+
+    bool ThreadPool::TryPop(std::size_t const index, std::function<void()> & task) {
+        {
+            // nested tasks newest first, as they usually split the task that is running; tasks from outside,
+            // e.g. the tiles of an image, in the order they were submitted.
+            Queue &         own = *_queues[index];
+            std::lock_guard lock(own.Mutex);
+            if (! own.Nested.empty()) {
+                task = std::move(own.Nested.back());
+                own.Nested.pop_back();
+                return true;
+            }
+            if (PopFront(own.Shared, task)) return true;
+        }
+        for (std::size_t k = 1; k < _queues.size(); ++k) {
+            Queue &         victim = *_queues[(index + k) % _queues.size()];
+            std::lock_guard lock(victim.Mutex);
+            if (PopFront(victim.Nested, task) || PopFront(victim.Shared, task)) return true;
+        }
+        return false;
+    }
+
+    bool ThreadPool::RunPending() {
+        std::function<void()> task;
+        if (t_Pool != this || ! TryPop(t_WorkerIndex, task)) return false;
+        _pending.fetch_sub(1);
+        task();
+        return true;
+    }
+
+    void ThreadPool::Run(std::size_t const index) {
+        t_Pool        = this;
+        t_WorkerIndex = index;
+        std::function<void()> task;
+        while (true) {
+            if (TryPop(index, task)) {
+                _pending.fetch_sub(1);
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock lock(_mutex);
+            _wake.wait(lock, [this]() { return _stop || _pending.load() > 0; });
+            if (_stop && _pending.load() == 0) return;
+        }
+    }
+
+    void TaskGroup::Run(std::function<void()> task) {
+        {
+            std::lock_guard lock(_mutex);
+            ++_count;
+        }
+        _pool.Submit([this, task = std::move(task)]() {
+            task();
+            // notified under the lock, so that Wait() cannot return and destroy the group before it is released.
+            std::lock_guard lock(_mutex);
+            if (--_count == 0) _done.notify_all();
+        });
+    }
+
+    void TaskGroup::Wait() {
+        std::unique_lock lock(_mutex);
+        if (_pool.GetWorkerIndex() == _pool.GetThreadCount()) {
+            _done.wait(lock, [this]() { return _count == 0; });
+            return;
+        }
+        while (_count > 0) {
+            lock.unlock();
+            if (! _pool.RunPending()) std::this_thread::yield();
+            lock.lock();
+        }
+    }
+}
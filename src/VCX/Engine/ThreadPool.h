@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VCX::Engine {
+    // a fixed set of workers, each with its own task deques. a worker runs the tasks it submitted itself newest
+    // first, then the tasks submitted from outside in submission order, and once it runs dry, steals the oldest
+    // tasks of the others before going to sleep.
+    class ThreadPool {
+    public:
+        // 0 uses every hardware thread.
+        explicit ThreadPool(std::size_t const numThreads = 0);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const &)             = delete;
+        ThreadPool & operator=(ThreadPool const &) = delete;
+
+        // tasks submitted from a worker go to its own deque, others are spread round-robin.
+        void Submit(std::function<void()> task);
+
+        std::size_t GetThreadCount() const { return _workers.size(); }
+
+        // index of the calling worker in [0, GetThreadCount()), or GetThreadCount() outside of this pool.
+        std::size_t GetWorkerIndex() const;
+
+        // runs one pending task on the calling worker, returns false if there was none or the caller is not a worker.
+        bool RunPending();
+
+    private:
+        struct Queue {
+            std::mutex                        Mutex;
+            std::deque<std::function<void()>> Nested; // submitted by the owning worker
+            std::deque<std::function<void()>> Shared; // submitted from outside the pool
+        };
+
+        void Run(std::size_t const index);
+        bool TryPop(std::size_t const index, std::function<void()> & task);
+
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread>            _workers;
+        std::mutex                          _mutex; // guards sleeping and _stop
+        std::condition_variable             _wake;
+        std::atomic<std::size_t>            _pending { 0 }; // submitted but not yet taken
+        std::atomic<std::size_t>            _next { 0 };
+        bool                                _stop { false };
+    };
+
+    // tasks of a pool that are waited for together, e.g. the halves of a fork/join. a worker of the pool that waits
+    // runs pending tasks meanwhile instead of blocking, so tasks may wait for the tasks they submit.
+    class TaskGroup {
+    public:
+        explicit TaskGroup(ThreadPool & pool):
+            _pool(pool) { }
+        ~TaskGroup() { Wait(); }
+
+        TaskGroup(TaskGroup const &)             = delete;
+        TaskGroup & operator=(TaskGroup const &) = delete;
+
+        void Run(std::function<void()> task);
+        void Wait();
+
+    private:
+        ThreadPool &            _pool;
+        std::mutex              _mutex; // guards _count
+        std::condition_variable _done;
+        std::size_t             _count { 0 }; // submitted and not finished
+    };
+}
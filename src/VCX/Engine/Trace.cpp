@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <fstream>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "Engine/Trace.h"
+
+namespace VCX::Engine {
+    static void AppendEscaped(std::string & out, std::string_view const str) {
+        for (char const c : str) {
+            if (c == '"' || c == '\\') out += '\\', out += c;
+            else if (static_cast<unsigned char>(c) < 0x20) out += fmt::format("\\u{:04x}", int(c));
+            else out += c;
+        }
+    }
+
+    Tracer & Tracer::Get() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    Tracer::Tracer():
+        _origin(Clock::now()) {
+        if (char const * const file = std::getenv("VCX_TRACE"); file && *file) {
+            _exitFile = file;
+            _enabled  = true;
+            // statics are destroyed in reverse order of construction; the logger has to outlive the write at exit.
+            spdlog::default_logger();
+        }
+    }
+
+    Tracer::~Tracer() {
+        if (! _exitFile.empty() && IsEnabled()) Stop(_exitFile);
+    }
+
+    std::uint32_t Tracer::GetThreadIndex() {
+        static std::atomic<std::uint32_t> next { 0 };
+        thread_local std::uint32_t const  index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    void Tracer::Start() {
+        {
+            std::lock_guard lock(_mutex);
+            _events.clear();
+        }
+        _enabled = true;
+    }
+
+    bool Tracer::Stop(std::filesystem::path const & fileName) {
+        _enabled = false;
+        return Write(fileName);
+    }
+
+    void Tracer::Record(Event && event) {
+        if (! IsEnabled()) return;
+        std::lock_guard lock(_mutex);
+        _events.push_back(std::move(event));
+    }
+
+    bool Tracer::Write(std::filesystem::path const & fileName) {
+        std::ofstream file(fileName);
+        if (! file) {
+            spdlog::error("VCX::Engine::Tracer::Write(\"{}\"): cannot write.", fileName.string());
+            return false;
+        }
+        std::lock_guard lock(_mutex);
+        // complete ("X") events with microsecond timestamps, the unit the format expects.
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"VCX\"}}";
+        for (auto const & event : _events)
+            file << fmt::format(
+                ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{},\"args\":{{{}}}}}",
+                event.Name,
+                event.Category,
+                event.Begin * 1e-3,
+                event.Duration * 1e-3,
+                event.Thread,
+                event.Args);
+        file << "\n]}\n";
+        spdlog::info("VCX::Engine::Tracer::Write(\"{}\"): {} events.", fileName.string(), _events.size());
+        return true;
+    }
+
+    void TraceScope::AddArg(std::string_view const key, std::string_view const value) {
+        if (! _active) return;
+        if (! _args.empty()) _args += ',';
+        _args += '"';
+        AppendEscaped(_args, key);
+        _args += "\":\"";
+        AppendEscaped(_args, value);
+        _args += '"';
+    }
+
+    void TraceScope::AddArg(std::string_view const key, std::int64_t const value) {
+        if (! _active) return;
+        if (! _args.empty()) _args += ',';
+        _args += '"';
+        AppendEscaped(_args, key);
+        _args += fmt::format("\":{}", value);
+    }
+
+    void TraceScope::End() {
+        std::int64_t const end = _tracer.GetTime();
+        _tracer.Record({ _name, _category, std::move(_args), _begin, end - _begin, Tracer::GetThreadIndex() });
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VCX::Engine {
+    // records timed scopes into memory and writes them as a Chrome trace-event file, which
+    // chrome://tracing and ui.perfetto.dev open. while stopped, a scope costs one relaxed load.
+    // setting VCX_TRACE=<file.json> starts it at first use and writes the file when the process exits,
+    // so loading done during static initialization is recorded as well.
+    class Tracer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Event {
+            char const *  Name;     // string literal
+            char const *  Category; // string literal
+            std::string   Args;     // members of the json args object, without braces
+            std::int64_t  Begin;    // in ns since the tracer was created
+            std::int64_t  Duration; // in ns
+            std::uint32_t Thread;
+        };
+
+        static Tracer & Get();
+
+        ~Tracer();
+
+        bool IsEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+        // drops the events recorded so far and begins recording.
+        void Start();
+
+        // stops recording and writes what was recorded. returns false, with an error emitted to spdlog, if it cannot be written.
+        bool Stop(std::filesystem::path const & fileName);
+
+        // events finished while the tracer is stopped are dropped.
+        void Record(Event && event);
+
+        std::int64_t GetTime() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _origin).count(); }
+
+        // dense per-process thread numbers, used as tid.
+        static std::uint32_t GetThreadIndex();
+
+    private:
+        Tracer();
+
+        bool Write(std::filesystem::path const & fileName);
+
+        Clock::time_point     _origin;
+        std::atomic<bool>     _enabled { false };
+        std::mutex            _mutex; // guards _events
+        std::vector<Event>    _events;
+        std::filesystem::path _exitFile; // from VCX_TRACE
+    };
+
+    // times its own lifetime into Tracer::Get(), if it was enabled when the scope began.
+    class TraceScope {
+    public:
+        explicit TraceScope(char const * name, char const * category = "engine"):
+            _tracer(Tracer::Get()),
+            _name(name),
+            _category(category),
+            _active(_tracer.IsEnabled()) {
+            if (_active) _begin = _tracer.GetTime();
+        }
+
+        // with the file name as argument, only taken apart while tracing.
+        TraceScope(char const * name, char const * category, std::filesystem::path const & file):
+            TraceScope(name, category) {
+            if (_active) AddArg("file", file.filename().string());
+        }
+
+        ~TraceScope() {
+            if (_active) End();
+        }
+
+        TraceScope(TraceScope const &)             = delete;
+        TraceScope & operator=(TraceScope const &) = delete;
+
+        bool IsActive() const { return _active; }
+
+        // no-ops unless active.
+        void AddArg(std::string_view const key, std::string_view const value);
+        void AddArg(std::string_view const key, std::int64_t const value);
+
+    private:
+        void End();
+
+        Tracer &     _tracer;
+        char const * _name;
+        char const * _category;
+        bool         _active;
+        std::int64_t _begin { 0 };
+        std::string  _args;
+    };
+}
@@ -11,6 +11,7 @@
 #include "imgui_impl_opengl3.h"
 
 #include "Engine/app.h"
+#include "Engine/Trace.h"
 
 static GLFWwindow *                      g_glfwWindow;
 static std::function<void()>             g_glfwWindowRefreshCallback;
@@ -66,6 +67,7 @@ namespace VCX::Engine::Internal {
     static void RunApp_Frame(IApp &);
 
     void RunApp_Init(AppContextOptions const & options) {
+        TraceScope const trace("InitApp", "app");
         RunApp_InitGLFW(options);
         #ifndef PLATFORM_MACOSX
             RunApp_InitGLFWWindowIcons(options);
@@ -185,6 +187,7 @@ namespace VCX::Engine::Internal {
     }
 
     static void RunApp_Frame(IApp & app) {
+        TraceScope const trace("Frame", "app");
         auto const currentTime = glfwGetTime();
         g_DeltaTime = currentTime - g_LastTime;
         g_LastTime  = currentTime;
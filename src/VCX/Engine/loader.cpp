@@ -3,10 +3,12 @@
 
 #include <spdlog/spdlog.h>
 #include <stb_image.h>
+#include <stb_image_write.h>
 #include <tiny_obj_loader.h>
 #include <yaml-cpp/yaml.h>
 
 #include "Engine/loader.h"
+#include "Engine/Trace.h"
 
 namespace std {
     template<>
@@ -106,6 +108,7 @@ namespace VCX::Engine {
     }
 
     Texture2D<Formats::R8> LoadImageGray(std::filesystem::path const & fileName, bool const flipped) {
+        TraceScope const trace("LoadImageGray", "load", fileName);
         auto const buf { LoadBytes(fileName) };
         int        width {}, height {}, channels {};
         stbi_set_flip_vertically_on_load(flipped);
@@ -128,6 +131,7 @@ namespace VCX::Engine {
     }
 
     Texture2D<Formats::RGB8> LoadImageRGB(std::filesystem::path const & fileName, bool const flipped) {
+        TraceScope const trace("LoadImageRGB", "load", fileName);
         auto const buf { LoadBytes(fileName) };
         int        width {}, height {}, channels {};
         stbi_set_flip_vertically_on_load(flipped);
@@ -150,6 +154,7 @@ namespace VCX::Engine {
     }
 
     Texture2D<Formats::RGBA8> LoadImageRGBA(std::filesystem::path const & fileName, bool const flipped) {
+        TraceScope const trace("LoadImageRGBA", "load", fileName);
         auto const buf { LoadBytes(fileName) };
         int        width {}, height {}, channels {};
         stbi_set_flip_vertically_on_load(flipped);
@@ -171,6 +176,17 @@ namespace VCX::Engine {
         return texture;
     }
 
+    bool SaveImagePNG(std::filesystem::path const & fileName, Texture2D<Formats::RGB8> const & image, bool const flipped) {
+        stbi_flip_vertically_on_write(flipped);
+        int const width  = int(image.GetSizeX());
+        int const height = int(image.GetSizeY());
+        if (! stbi_write_png(fileName.string().c_str(), width, height, 3, image.GetBytes().data(), 3 * width)) {
+            spdlog::error("VCX::Engine::SaveImagePNG(\"{}\"): cannot write.", fileName.string());
+            return false;
+        }
+        return true;
+    }
+
     static void AddUniqueVertices(
         tinyobj::attrib_t                                            const & attrib,
         std::vector<tinyobj::index_t>                                const & indices,
@@ -229,6 +245,7 @@ namespace VCX::Engine {
     }
 
     SurfaceMesh LoadSurfaceMesh(std::filesystem::path const & fileName, bool const simplified) {
+        TraceScope const trace("LoadSurfaceMesh", "load", fileName);
         auto const ext = fileName.extension();
         if (ext == ".obj") {
             return LoadSurfaceMeshOBJ(fileName, simplified);
@@ -299,6 +316,7 @@ namespace VCX::Engine {
     }
 
     static void LoadComplexModels(std::filesystem::path const & fileName, std::vector<Material> & materials, std::vector<Model> & models) {
+        TraceScope const trace("LoadComplexModels", "load", fileName);
         auto const ext = fileName.extension();
         if (ext == ".obj") {
             LoadComplexModelsOBJ(fileName, materials, models);
@@ -308,6 +326,7 @@ namespace VCX::Engine {
     }
 
     Scene LoadScene(std::filesystem::path const & fileName) {
+        TraceScope const trace("LoadScene", "load", fileName);
 		std::ifstream fin(fileName);
 		if (!fin) {
             spdlog::error("VCX::Engine::LoadScene(\"{}\"): not found.", fileName.filename().string());
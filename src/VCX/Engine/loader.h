@@ -15,6 +15,9 @@ namespace VCX::Engine {
     Texture2D<Formats::RGB8>  LoadImageRGB (std::filesystem::path const & fileName, bool const flipped = false);
     Texture2D<Formats::RGBA8> LoadImageRGBA(std::filesystem::path const & fileName, bool const flipped = false);
 
+    // flipped writes the last row first. returns false, with an error emitted to spdlog, if the file cannot be written.
+    bool SaveImagePNG(std::filesystem::path const & fileName, Texture2D<Formats::RGB8> const & image, bool const flipped = false);
+
     SurfaceMesh LoadSurfaceMesh(std::filesystem::path const & fileName, bool const simplified = false);
 
     Scene LoadScene (std::filesystem::path const & fileName);
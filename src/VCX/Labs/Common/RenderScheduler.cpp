@@ -0,0 +1,47 @@
+#include <algorithm>
+
+#include "Labs/Common/RenderScheduler.h"
+
+namespace VCX::Labs::Common {
+    RenderScheduler & RenderScheduler::Get() {
+        static RenderScheduler scheduler;
+        return scheduler;
+    }
+
+    void RenderScheduler::Register(ICase const * owner, std::function<void()> suspend, std::function<void()> resume) {
+        std::lock_guard lock(_mutex);
+        _clients.push_back({ owner, std::move(suspend), std::move(resume) });
+    }
+
+    void RenderScheduler::Unregister(ICase const * owner) {
+        std::lock_guard lock(_mutex);
+        std::erase_if(_clients, [&](Client const & client) { return client.Owner == owner; });
+        if (_visible == owner) _visible = nullptr;
+    }
+
+    void RenderScheduler::SetVisible(ICase const * owner) {
+        std::vector<std::function<void()>> calls;
+        {
+            std::lock_guard lock(_mutex);
+            if (owner == _visible) return;
+            for (auto const & client : _clients)
+                if (client.Owner == _visible && client.Suspend) calls.push_back(client.Suspend);
+            for (auto const & client : _clients)
+                if (client.Owner == owner && client.Resume) calls.push_back(client.Resume);
+            _visible = owner;
+        }
+        // suspend first, so that the pool is free by the time the new case resumes.
+        for (auto const & call : calls) call();
+    }
+
+    bool RenderScheduler::IsVisible(ICase const * owner) const {
+        std::lock_guard lock(_mutex);
+        return owner == _visible;
+    }
+
+    Engine::ThreadPool & RenderScheduler::GetPool() {
+        std::lock_guard lock(_mutex);
+        if (! _pool) _pool = std::make_unique<Engine::ThreadPool>();
+        return *_pool;
+    }
+}
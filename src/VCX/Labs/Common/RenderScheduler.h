@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Engine/Async.hpp"
+#include "Engine/ThreadPool.h"
+
+namespace VCX::Labs::Common {
+    class ICase; // only compared by address, which keeps this header free of GL for headless builds.
+
+    // process-wide home of the background rendering of every case. all cases share one pool sized to the machine,
+    // the case on screen queues its work ahead of the others, and a case that leaves the screen is suspended
+    // until it comes back.
+    class RenderScheduler {
+    public:
+        static RenderScheduler & Get();
+
+        // suspend has to stop the background work of owner so that resume can continue it later.
+        // both are called on the UI thread from SetVisible(..).
+        void Register(ICase const * owner, std::function<void()> suspend, std::function<void()> resume);
+        void Unregister(ICase const * owner);
+
+        // called by UI every frame with the case about to be drawn.
+        void SetVisible(ICase const * owner);
+        bool IsVisible(ICase const * owner) const;
+
+        // queues a long-running job of owner, at high priority if owner is on screen.
+        template<typename T>
+        Engine::Async<T> Submit(ICase const * owner, std::function<T()> && work) {
+            return Engine::Async<T>(std::move(work), IsVisible(owner) ? Engine::AsyncPriority::High : Engine::AsyncPriority::Low);
+        }
+
+        // the same for a job that polls the token, so that Reset() or Cancel() on the result stops it early.
+        template<typename T>
+        Engine::Async<T> Submit(ICase const * owner, typename Engine::Async<T>::CancelableFunc && work) {
+            return Engine::Async<T>(std::move(work), IsVisible(owner) ? Engine::AsyncPriority::High : Engine::AsyncPriority::Low);
+        }
+
+        // for the short tasks a job splits into, e.g. tiles; one worker per hardware thread, created on first use.
+        Engine::ThreadPool & GetPool();
+
+    private:
+        struct Client {
+            ICase const *         Owner;
+            std::function<void()> Suspend;
+            std::function<void()> Resume;
+        };
+
+        mutable std::mutex                  _mutex;
+        std::vector<Client>                 _clients;
+        ICase const *                       _visible { nullptr };
+        std::unique_ptr<Engine::ThreadPool> _pool;
+    };
+}
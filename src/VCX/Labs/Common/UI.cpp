@@ -7,6 +7,7 @@
 
 #include "Engine/app.h"
 #include "Labs/Common/ImGuiHelper.h"
+#include "Labs/Common/RenderScheduler.h"
 #include "Labs/Common/UI.h"
 
 namespace VCX::Labs::Common {
@@ -31,6 +32,7 @@ namespace VCX::Labs::Common {
         if (! _layout.SideWindowHidden)
             newCaseId = setupSideWindow(cases, caseId);
 
+        RenderScheduler::Get().SetVisible(&cases[caseId].get());
         setupMainWindow(cases[caseId]);
         
         if (caseId != newCaseId)
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Engine/prelude.hpp"
+#include "Engine/Scene.h"
+
+namespace VCX::Labs::Rendering {
+
+    struct AABB {
+        glm::vec3 Min { std::numeric_limits<float>::max() };
+        glm::vec3 Max { -std::numeric_limits<float>::max() };
+
+        void Extend(glm::vec3 const & p) {
+            Min = glm::min(Min, p);
+            Max = glm::max(Max, p);
+        }
+
+        void Extend(AABB const & o) {
+            Min = glm::min(Min, o.Min);
+            Max = glm::max(Max, o.Max);
+        }
+
+        bool      IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+        glm::vec3 GetCenter() const { return (Min + Max) * .5f; }
+
+        float GetSurfaceArea() const {
+            if (IsEmpty()) return 0;
+            glm::vec3 const d = Max - Min;
+            return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        // slab test against [tMin, tMax]; invDir is the reciprocal of a normalized direction.
+        bool IntersectRay(glm::vec3 const & origin, glm::vec3 const & invDir, float const tMin, float const tMax, float & tNear) const {
+            float tFar;
+            return IntersectRay(origin, invDir, tMin, tMax, tNear, tFar);
+        }
+
+        bool IntersectRay(glm::vec3 const & origin, glm::vec3 const & invDir, float const tMin, float const tMax, float & tNear, float & tFar) const {
+            glm::vec3 const t0 = (Min - origin) * invDir;
+            glm::vec3 const t1 = (Max - origin) * invDir;
+            glm::vec3 const lo = glm::min(t0, t1);
+            glm::vec3 const hi = glm::max(t0, t1);
+            tNear              = glm::max(glm::max(lo.x, lo.y), glm::max(lo.z, tMin));
+            tFar               = glm::min(glm::min(hi.x, hi.y), glm::min(hi.z, tMax));
+            return tNear <= tFar;
+        }
+    };
+
+    // binary BVH node, also the input of the wide layouts.
+    struct BVHNode {
+        AABB          Bounds;
+        std::uint32_t Offset; // first primitive for leaves, right child for interior nodes (left child is the next node)
+        std::uint32_t Count;  // number of primitives, 0 for interior nodes
+    };
+
+    // triangle vertices copied out of the scene so that traversal never touches the source meshes.
+    struct AccelTriangle {
+        glm::vec3     P1, P2, P3;
+        std::uint32_t ModelIndex;
+        std::uint32_t FaceIndex; // offset into Model::Mesh::Indices
+    };
+
+    struct AccelHit {
+        float         T, U, V;
+        std::uint32_t ModelIndex;
+        std::uint32_t FaceIndex;
+    };
+
+    // decides whether a candidate hit of an any-hit query blocks the ray, e.g. by evaluating alpha.
+    // a plain function pointer keeps shadow rays free of allocations; a null Accept takes every hit.
+    struct AnyHitFilter {
+        bool (*Accept)(void const * context, AccelHit const & hit) { nullptr };
+        void const * Context { nullptr };
+
+        bool operator()(AccelHit const & hit) const { return ! Accept || Accept(Context, hit); }
+    };
+
+    // nodes and triangles the traversals of the calling thread went through. they only grow, readers take differences.
+    struct TraversalCounters {
+        std::uint64_t NodesVisited    { 0 };
+        std::uint64_t TrianglesTested { 0 };
+    };
+
+    inline TraversalCounters & GetTraversalCounters() {
+        thread_local TraversalCounters counters;
+        return counters;
+    }
+
+    // counts in locals for the duration of one traversal and adds them to GetTraversalCounters() on the way out.
+    struct TraversalTally {
+        std::uint32_t Nodes     { 0 };
+        std::uint32_t Triangles { 0 };
+
+        ~TraversalTally() {
+            TraversalCounters & counters = GetTraversalCounters();
+            counters.NodesVisited += Nodes;
+            counters.TrianglesTested += Triangles;
+        }
+    };
+
+    struct AccelStatistics {
+        std::size_t NumTriangles   { 0 };
+        std::size_t NumNodes       { 0 };
+        std::size_t NumLeaves      { 0 };
+        std::size_t NumReferences  { 0 }; // triangle references stored in leaves, exceeds NumTriangles for spatial splits
+        std::size_t MaxDepth       { 0 };
+        std::size_t NodeBytes      { 0 }; // memory held by the hierarchy itself
+        std::size_t PrimitiveBytes { 0 }; // memory held by the triangles and references in leaf order
+        float       SAHCost        { 0 };
+        double      BuildTime      { 0 }; // in milliseconds
+    };
+
+    inline void GatherTriangles(std::vector<AccelTriangle> & triangles, Engine::SurfaceMesh const & mesh, std::uint32_t const modelIdx) {
+        for (std::size_t j = 0; j + 2 < mesh.Indices.size(); j += 3) {
+            std::uint32_t const * face = mesh.Indices.data() + j;
+            triangles.push_back({ mesh.Positions[face[0]], mesh.Positions[face[1]], mesh.Positions[face[2]], modelIdx, std::uint32_t(j) });
+        }
+    }
+
+    inline std::vector<AccelTriangle> GatherTriangles(Engine::Scene const & scene) {
+        std::vector<AccelTriangle> triangles;
+        for (std::size_t i = 0; i < scene.Models.size(); ++i)
+            GatherTriangles(triangles, scene.Models[i].Mesh, std::uint32_t(i));
+        return triangles;
+    }
+
+    // 64-bit content hash, processed a word at a time; only meant to identify geometry, not for security.
+    inline std::uint64_t HashBytes(std::span<std::byte const> const bytes, std::uint64_t seed = 0) {
+        auto const Mix = [](std::uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        };
+        std::uint64_t h = seed ^ (bytes.size() * 0x9e3779b97f4a7c15ull);
+        std::size_t   i = 0;
+        for (; i + 8 <= bytes.size(); i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes.data() + i, 8);
+            h = std::rotl(h ^ Mix(word), 27) * 0x9e3779b97f4a7c15ull;
+        }
+        std::uint64_t tail = 0;
+        if (i < bytes.size()) std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+        return Mix(h ^ tail);
+    }
+
+    inline std::uint64_t HashMesh(Engine::SurfaceMesh const & mesh) {
+        return HashBytes(Engine::make_span_bytes<std::uint32_t>(mesh.Indices), HashBytes(Engine::make_span_bytes<glm::vec3>(mesh.Positions)));
+    }
+
+    // raw dumps for the on-disk caches, only meant to be read back by the same build on the same machine.
+    template<typename T>
+    void WriteRaw(std::ostream & out, T const & value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadRaw(std::istream & in, T & value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return bool(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+
+    template<typename T>
+    void WriteArray(std::ostream & out, std::vector<T> const & values) {
+        WriteRaw(out, std::uint64_t(values.size()));
+        out.write(reinterpret_cast<char const *>(values.data()), std::streamsize(values.size() * sizeof(T)));
+    }
+
+    template<typename T>
+    bool ReadArray(std::istream & in, std::vector<T> & values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::uint64_t count;
+        if (! ReadRaw(in, count)) return false;
+        // reject counts that do not fit in the rest of the stream before allocating anything.
+        auto const pos = in.tellg();
+        in.seekg(0, std::ios::end);
+        auto const size = in.tellg();
+        in.seekg(pos);
+        if (pos < 0 || size < pos || count > std::uint64_t(size - pos) / sizeof(T)) return false;
+        values.resize(std::size_t(count));
+        return bool(in.read(reinterpret_cast<char *>(values.data()), std::streamsize(count * sizeof(T))));
+    }
+
+} // namespace VCX::Labs::Rendering
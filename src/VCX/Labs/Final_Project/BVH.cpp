@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "Engine/ThreadPool.h"
+#include "Engine/Trace.h"
+#include "Labs/Common/RenderScheduler.h"
+#include "Labs/Final_Project/BVH.h"
+#include "Labs/Final_Project/tasks.h"
+
+namespace VCX::Labs::Rendering {
+
+    static constexpr std::size_t c_MaxBVHDepth          = 64; // also bounds the traversal stack
+    static constexpr int         c_MaxBVHBins           = 64;
+    static constexpr std::size_t c_MinParallelBuildSize = 4096; // smaller subtrees are not worth a task
+
+    namespace {
+        struct BuildPrimitive {
+            AABB          Bounds;
+            glm::vec3     Centroid;
+            std::uint32_t Index;
+            std::uint32_t MortonCode { 0 };
+        };
+
+        struct BuildBin {
+            AABB        Bounds;
+            std::size_t Count { 0 };
+        };
+
+        struct BuildContext {
+            BVHBuildOptions const &       Options;
+            std::vector<BuildPrimitive> & Primitives;
+            std::size_t                   ParallelDepth; // both children of nodes above this depth are built concurrently
+        };
+    } // namespace
+
+    // builds fork into tasks of the machine-sized pool of the RenderScheduler, which a waiting worker helps to run.
+    static Engine::ThreadPool & GetBuildPool() {
+        return Common::RenderScheduler::Get().GetPool();
+    }
+
+    static std::size_t GetBuildThreadCount(BVHBuildOptions const & options) {
+        return options.NumThreads > 0 ? std::size_t(options.NumThreads) : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // binned SAH: evaluates NumBins - 1 candidate planes on each axis of the centroid bounds.
+    // returns the partition point, or begin when a leaf is cheaper.
+    static std::size_t SplitSAH(BuildContext & ctx, std::size_t const begin, std::size_t const end, AABB const & bounds, AABB const & centroidBounds) {
+        std::size_t const count     = end - begin;
+        int const         numBins   = std::clamp(ctx.Options.NumBins, 2, c_MaxBVHBins);
+        float const       invArea   = 1.f / std::max(bounds.GetSurfaceArea(), std::numeric_limits<float>::min());
+        glm::vec3 const   extent    = centroidBounds.Max - centroidBounds.Min;
+        float             bestCost  = std::numeric_limits<float>::max();
+        int               bestAxis  = -1;
+        int               bestSplit = -1;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0) continue;
+            std::array<BuildBin, c_MaxBVHBins> bins;
+            float const                        scale = numBins / extent[axis];
+            for (std::size_t i = begin; i < end; ++i) {
+                int const b = std::min(numBins - 1, int((ctx.Primitives[i].Centroid[axis] - centroidBounds.Min[axis]) * scale));
+                bins[b].Count++;
+                bins[b].Bounds.Extend(ctx.Primitives[i].Bounds);
+            }
+            std::array<float, c_MaxBVHBins>       rightArea;
+            std::array<std::size_t, c_MaxBVHBins> rightCount;
+            AABB                                  rightBounds;
+            std::size_t                           rightSum = 0;
+            for (int b = numBins - 1; b > 0; --b) {
+                rightBounds.Extend(bins[b].Bounds);
+                rightSum += bins[b].Count;
+                rightArea[b]  = rightBounds.GetSurfaceArea();
+                rightCount[b] = rightSum;
+            }
+            AABB        leftBounds;
+            std::size_t leftSum = 0;
+            for (int s = 1; s < numBins; ++s) {
+                leftBounds.Extend(bins[s - 1].Bounds);
+                leftSum += bins[s - 1].Count;
+                if (leftSum == 0 || rightCount[s] == 0) continue;
+                float const cost = ctx.Options.TraversalCost
+                    + ctx.Options.IntersectionCost * (leftBounds.GetSurfaceArea() * leftSum + rightArea[s] * rightCount[s]) * invArea;
+                if (cost < bestCost) {
+                    bestCost  = cost;
+                    bestAxis  = axis;
+                    bestSplit = s;
+                }
+            }
+        }
+
+        float const leafCost = ctx.Options.IntersectionCost * count;
+        if (bestAxis < 0 || (bestCost >= leafCost && count <= std::size_t(ctx.Options.MaxLeafSize))) return begin;
+
+        float const scale = numBins / extent[bestAxis];
+        auto const  midIt = std::partition(ctx.Primitives.begin() + begin, ctx.Primitives.begin() + end, [&](BuildPrimitive const & prim) {
+            return std::min(numBins - 1, int((prim.Centroid[bestAxis] - centroidBounds.Min[bestAxis]) * scale)) < bestSplit;
+        });
+        return std::size_t(midIt - ctx.Primitives.begin());
+    }
+
+    // LBVH: primitives are sorted by Morton code, nodes split at the highest bit that differs within their range.
+    static std::size_t SplitMorton(BuildContext & ctx, std::size_t const begin, std::size_t const end) {
+        if (end - begin <= std::size_t(std::max(ctx.Options.MaxLeafSize, 1))) return begin;
+        std::uint32_t const first = ctx.Primitives[begin].MortonCode;
+        std::uint32_t const last  = ctx.Primitives[end - 1].MortonCode;
+        if (first == last) return (begin + end) / 2;
+        std::uint32_t const bit   = std::uint32_t(1) << (31 - std::countl_zero(first ^ last));
+        auto const          midIt = std::partition_point(ctx.Primitives.begin() + begin, ctx.Primitives.begin() + end, [&](BuildPrimitive const & prim) {
+            return (prim.MortonCode & bit) == 0;
+        });
+        return std::size_t(midIt - ctx.Primitives.begin());
+    }
+
+    // appends a subtree built into its own array, rebasing its child links.
+    static void SpliceNodes(std::vector<BVHNode> & nodes, std::vector<BVHNode> const & subtree) {
+        auto const base = std::uint32_t(nodes.size());
+        for (BVHNode node : subtree) {
+            if (node.Count == 0) node.Offset += base;
+            nodes.push_back(node);
+        }
+    }
+
+    static std::uint32_t BuildRecursive(BuildContext & ctx, std::vector<BVHNode> & nodes, AccelStatistics & statistics, std::size_t const begin, std::size_t const end, std::size_t const depth) {
+        auto const nodeIdx = std::uint32_t(nodes.size());
+        nodes.emplace_back();
+
+        AABB bounds, centroidBounds;
+        for (std::size_t i = begin; i < end; ++i) {
+            bounds.Extend(ctx.Primitives[i].Bounds);
+            centroidBounds.Extend(ctx.Primitives[i].Centroid);
+        }
+        std::size_t const count = end - begin;
+        nodes[nodeIdx].Bounds   = bounds;
+        statistics.MaxDepth     = std::max(statistics.MaxDepth, depth);
+
+        auto const MakeLeaf = [&]() {
+            nodes[nodeIdx].Offset = std::uint32_t(begin);
+            nodes[nodeIdx].Count  = std::uint32_t(count);
+            ++statistics.NumLeaves;
+            return nodeIdx;
+        };
+        if (count <= 1 || depth + 1 >= c_MaxBVHDepth) return MakeLeaf();
+
+        std::size_t const mid = ctx.Options.Builder == BVHBuilder::Morton
+            ? SplitMorton(ctx, begin, end)
+            : SplitSAH(ctx, begin, end, bounds, centroidBounds);
+        if (mid == begin || mid == end) return MakeLeaf();
+
+        std::uint32_t right;
+        if (depth < ctx.ParallelDepth && count >= c_MinParallelBuildSize) {
+            // the children own disjoint primitive ranges, so they can be built into separate arrays and spliced in order.
+            std::vector<BVHNode> leftNodes, rightNodes;
+            AccelStatistics      leftStatistics, rightStatistics;
+            Engine::TaskGroup    leftTask(GetBuildPool());
+            leftTask.Run([&]() { BuildRecursive(ctx, leftNodes, leftStatistics, begin, mid, depth + 1); });
+            BuildRecursive(ctx, rightNodes, rightStatistics, mid, end, depth + 1);
+            leftTask.Wait();
+            SpliceNodes(nodes, leftNodes);
+            right = std::uint32_t(nodes.size());
+            SpliceNodes(nodes, rightNodes);
+            statistics.NumLeaves += leftStatistics.NumLeaves + rightStatistics.NumLeaves;
+            statistics.MaxDepth = std::max({ statistics.MaxDepth, leftStatistics.MaxDepth, rightStatistics.MaxDepth });
+        } else {
+            BuildRecursive(ctx, nodes, statistics, begin, mid, depth + 1);
+            right = BuildRecursive(ctx, nodes, statistics, mid, end, depth + 1);
+        }
+        nodes[nodeIdx].Offset = right;
+        nodes[nodeIdx].Count  = 0;
+        return nodeIdx;
+    }
+
+    // spreads the 10 low bits of x so that there are two zero bits between each of them.
+    static std::uint32_t ExpandBits(std::uint32_t x) {
+        x = (x * 0x00010001u) & 0xFF0000FFu;
+        x = (x * 0x00000101u) & 0x0F00F00Fu;
+        x = (x * 0x00000011u) & 0xC30C30C3u;
+        x = (x * 0x00000005u) & 0x49249249u;
+        return x;
+    }
+
+    // sorts chunks of prims as separate tasks, then merges them pairwise.
+    static void SortByMortonCode(std::vector<BuildPrimitive> & prims, std::size_t const numThreads) {
+        auto const Less = [](BuildPrimitive const & a, BuildPrimitive const & b) {
+            return a.MortonCode < b.MortonCode || (a.MortonCode == b.MortonCode && a.Index < b.Index);
+        };
+        std::size_t const numChunks = std::bit_floor(std::clamp<std::size_t>(prims.size() / c_MinParallelBuildSize, 1, numThreads));
+        std::vector<std::size_t> bounds(numChunks + 1);
+        for (std::size_t i = 0; i <= numChunks; ++i) bounds[i] = prims.size() * i / numChunks;
+
+        Engine::TaskGroup tasks(GetBuildPool());
+        for (std::size_t i = 0; i < numChunks; ++i)
+            tasks.Run([&, i]() { std::sort(prims.begin() + bounds[i], prims.begin() + bounds[i + 1], Less); });
+        tasks.Wait();
+        for (std::size_t width = 1; width < numChunks; width *= 2) {
+            for (std::size_t i = 0; i + width < numChunks; i += 2 * width)
+                tasks.Run([&, i, width]() {
+                    std::inplace_merge(prims.begin() + bounds[i], prims.begin() + bounds[i + width], prims.begin() + bounds[i + 2 * width], Less);
+                });
+            tasks.Wait();
+        }
+    }
+
+    // builds the hierarchy over prims, which are reordered into leaf order.
+    static void BuildNodes(std::vector<BuildPrimitive> & prims, BVHBuildOptions const & options, std::vector<BVHNode> & nodes, AccelStatistics & statistics) {
+        std::size_t const numThreads = GetBuildThreadCount(options);
+        if (options.Builder == BVHBuilder::Morton) {
+            AABB centroidBounds;
+            for (auto const & prim : prims) centroidBounds.Extend(prim.Centroid);
+            glm::vec3 const scale = 1023.f / glm::max(centroidBounds.Max - centroidBounds.Min, glm::vec3(std::numeric_limits<float>::min()));
+            for (auto & prim : prims) {
+                glm::uvec3 const cell = glm::uvec3(glm::clamp((prim.Centroid - centroidBounds.Min) * scale, glm::vec3(0), glm::vec3(1023)));
+                prim.MortonCode       = (ExpandBits(cell.x) << 2) | (ExpandBits(cell.y) << 1) | ExpandBits(cell.z);
+            }
+            SortByMortonCode(prims, numThreads);
+        }
+
+        // a few levels more than log2(threads) so that unbalanced splits still keep every core busy.
+        BuildContext ctx {
+            .Options       = options,
+            .Primitives    = prims,
+            .ParallelDepth = numThreads > 1 ? std::size_t(std::bit_width(numThreads - 1)) + 2 : 0,
+        };
+        nodes.reserve(2 * prims.size());
+        BuildRecursive(ctx, nodes, statistics, 0, prims.size(), 0);
+        nodes.shrink_to_fit();
+        statistics.NumNodes += nodes.size();
+    }
+
+    // front-to-back traversal; leaf(offset, count) tests the primitives of a leaf, may shrink tBest and returns true to stop.
+    template<typename LeafFunc>
+    static void Traverse(std::vector<BVHNode> const & nodes, glm::vec3 const & origin, glm::vec3 const & invDir, float const tMin, float & tBest, LeafFunc && leaf) {
+        float tNear;
+        if (nodes.empty() || ! nodes[0].Bounds.IntersectRay(origin, invDir, tMin, tBest, tNear)) return;
+        std::array<std::uint32_t, c_MaxBVHDepth> stack;
+        std::size_t                              top = 0;
+        stack[top++]                                 = 0;
+        TraversalTally                           tally;
+        while (top > 0) {
+            std::uint32_t const idx  = stack[--top];
+            BVHNode const &     node = nodes[idx];
+            ++tally.Nodes;
+            if (node.Count > 0) {
+                if (leaf(node.Offset, node.Count)) return;
+                continue;
+            }
+            // visit the nearer child first, and skip children beyond the closest hit found so far.
+            std::uint32_t near = idx + 1, far = node.Offset;
+            float         tNearL, tNearR;
+            bool const    hitL = nodes[near].Bounds.IntersectRay(origin, invDir, tMin, tBest, tNearL);
+            bool const    hitR = nodes[far].Bounds.IntersectRay(origin, invDir, tMin, tBest, tNearR);
+            if (hitL && hitR) {
+                if (tNearR < tNearL) std::swap(near, far);
+                stack[top++] = far;
+                stack[top++] = near;
+            } else if (hitL) {
+                stack[top++] = near;
+            } else if (hitR) {
+                stack[top++] = far;
+            }
+        }
+    }
+
+    void BVH::Build(Engine::SurfaceMesh const & mesh, BVHBuildOptions const & options) {
+        auto const start = std::chrono::steady_clock::now();
+        Clear();
+
+        std::vector<AccelTriangle> triangles;
+        GatherTriangles(triangles, mesh, 0);
+        _statistics.NumTriangles = triangles.size();
+        if (triangles.empty()) return;
+
+        std::vector<BuildPrimitive> prims(triangles.size());
+        for (std::size_t i = 0; i < triangles.size(); ++i) {
+            prims[i].Bounds.Extend(triangles[i].P1);
+            prims[i].Bounds.Extend(triangles[i].P2);
+            prims[i].Bounds.Extend(triangles[i].P3);
+            prims[i].Centroid = prims[i].Bounds.GetCenter();
+            prims[i].Index    = std::uint32_t(i);
+        }
+        BuildNodes(prims, options, _nodes, _statistics);
+        _bounds = _nodes[0].Bounds;
+
+        _triangles.resize(triangles.size());
+        for (std::size_t i = 0; i < prims.size(); ++i)
+            _triangles[i] = triangles[prims[i].Index];
+
+        float const invRootArea = 1.f / std::max(_bounds.GetSurfaceArea(), std::numeric_limits<float>::min());
+        for (auto const & node : _nodes)
+            _statistics.SAHCost += node.Bounds.GetSurfaceArea() * invRootArea * (node.Count ? options.IntersectionCost * node.Count : options.TraversalCost);
+        _statistics.NumReferences = _triangles.size();
+
+        _statistics.NodeBytes      = _nodes.size() * sizeof(BVHNode);
+        _statistics.PrimitiveBytes = _triangles.size() * sizeof(AccelTriangle);
+
+        if (options.Layout != BVHLayout::Binary) {
+            // the binary tree is only the input of the collapse, the SAH cost above is kept as its estimate.
+            _wide.Build(_nodes, _triangles, options.Layout == BVHLayout::Wide8Quantized);
+            _statistics.NumNodes       = _wide.GetNodeCount();
+            _statistics.MaxDepth       = _wide.GetDepth() - 1;
+            _statistics.NodeBytes      = _wide.GetNodeBytes();
+            _statistics.PrimitiveBytes = _wide.GetTriangleBytes();
+            std::vector<BVHNode>().swap(_nodes);
+            std::vector<AccelTriangle>().swap(_triangles);
+        }
+        _statistics.BuildTime     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        spdlog::trace(
+            "VCX::Labs::Rendering::BVH::Build(..): {} triangles, {} nodes, {} leaves, depth {}, SAH cost {:.2f}, {:.1f} ms.",
+            _statistics.NumTriangles,
+            _statistics.NumNodes,
+            _statistics.NumLeaves,
+            _statistics.MaxDepth,
+            _statistics.SAHCost,
+            _statistics.BuildTime);
+    }
+
+    void BVH::Clear() {
+        _bounds = AABB();
+        _nodes.clear();
+        _triangles.clear();
+        _wide.Clear();
+        _statistics = AccelStatistics();
+    }
+
+    void BVH::Write(std::ostream & out) const {
+        WriteRaw(out, _bounds);
+        WriteRaw(out, _statistics);
+        WriteArray(out, _nodes);
+        WriteArray(out, _triangles);
+        _wide.Write(out);
+    }
+
+    bool BVH::Read(std::istream & in) {
+        Clear();
+        if (ReadRaw(in, _bounds) && ReadRaw(in, _statistics) && ReadArray(in, _nodes) && ReadArray(in, _triangles) && _wide.Read(in)) return true;
+        Clear();
+        return false;
+    }
+
+    bool BVH::Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const {
+        if (! _wide.IsEmpty()) return _wide.Intersect(ray, tMin, tMax, hit);
+        glm::vec3 const invDir = 1.f / glm::normalize(ray.Direction);
+        float           tBest  = tMax;
+        bool            found  = false;
+        TraversalTally  tally;
+        Traverse(_nodes, ray.Origin, invDir, tMin, tBest, [&](std::uint32_t const offset, std::uint32_t const count) {
+            Intersection its;
+            tally.Triangles += count;
+            for (std::uint32_t k = offset; k < offset + count; ++k) {
+                AccelTriangle const & tri = _triangles[k];
+                if (! IntersectTriangle(its, ray, tri.P1, tri.P2, tri.P3)) continue;
+                if (its.t < tMin || its.t > tBest) continue;
+                tBest         = its.t;
+                hit.T         = its.t;
+                hit.U         = its.u;
+                hit.V         = its.v;
+                hit.FaceIndex = tri.FaceIndex;
+                found         = true;
+            }
+            return false;
+        });
+        return found;
+    }
+
+    bool BVH::Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter) const {
+        if (! _wide.IsEmpty()) return _wide.Occluded(ray, tMin, tMax, filter);
+        glm::vec3 const invDir   = 1.f / glm::normalize(ray.Direction);
+        float           tBest    = tMax;
+        bool            occluded = false;
+        TraversalTally  tally;
+        Traverse(_nodes, ray.Origin, invDir, tMin, tBest, [&](std::uint32_t const offset, std::uint32_t const count) {
+            Intersection its;
+            for (std::uint32_t k = offset; k < offset + count; ++k) {
+                AccelTriangle const & tri = _triangles[k];
+                ++tally.Triangles;
+                if (! IntersectTriangle(its, ray, tri.P1, tri.P2, tri.P3)) continue;
+                if (its.t < tMin || its.t > tMax) continue;
+                if (filter({ its.t, its.u, its.v, tri.ModelIndex, tri.FaceIndex })) return occluded = true;
+            }
+            return false;
+        });
+        return occluded;
+    }
+
+    BVHCache & BVHCache::Get() {
+        static BVHCache cache;
+        return cache;
+    }
+
+    // bump whenever the serialized layout of BVH, WideBVH or their nodes changes.
+    static constexpr std::uint32_t c_BVHFileMagic   = 0x48564258; // "XBVH"
+    static constexpr std::uint32_t c_BVHFileVersion = 2;
+
+    std::filesystem::path BVHCache::GetFilePath(std::filesystem::path const & directory, Key const & key) {
+        auto const & [meshHash, numPositions, numIndices, layout, builder, numBins, maxLeafSize, traversalCost, intersectionCost] = key;
+        std::uint64_t const fields[] {
+            numPositions,
+            numIndices,
+            std::uint64_t(layout),
+            std::uint64_t(builder),
+            std::uint64_t(numBins),
+            std::uint64_t(maxLeafSize),
+            std::bit_cast<std::uint32_t>(traversalCost),
+            std::bit_cast<std::uint32_t>(intersectionCost),
+        };
+        return directory / fmt::format("{:016x}-{:016x}.bvh", meshHash, HashBytes(std::as_bytes(std::span(fields))));
+    }
+
+    std::shared_ptr<BVH> BVHCache::LoadFile(std::filesystem::path const & path, Key const & key) {
+        Engine::TraceScope const trace("LoadBLAS", "build", path);
+        // read the whole file in bulk rather than mapping it, which keeps this portable and costs little next to a rebuild.
+        std::ifstream in(path, std::ios::binary);
+        if (! in) return nullptr;
+        std::uint32_t magic, version, nodeSize, wideNodeSize, blockSize;
+        Key           fileKey;
+        bool const    valid = ReadRaw(in, magic) && ReadRaw(in, version) && ReadRaw(in, nodeSize) && ReadRaw(in, wideNodeSize) && ReadRaw(in, blockSize)
+            && ReadRaw(in, std::get<0>(fileKey)) && ReadRaw(in, std::get<1>(fileKey)) && ReadRaw(in, std::get<2>(fileKey))
+            && magic == c_BVHFileMagic && version == c_BVHFileVersion && nodeSize == sizeof(BVHNode)
+            && wideNodeSize == sizeof(WideBVHNode) && blockSize == sizeof(WideTriangleBlock)
+            && std::get<0>(fileKey) == std::get<0>(key) && std::get<1>(fileKey) == std::get<1>(key) && std::get<2>(fileKey) == std::get<2>(key);
+        auto bvh = std::make_shared<BVH>();
+        if (! valid || ! bvh->Read(in)) {
+            spdlog::warn("VCX::Labs::Rendering::BVHCache::LoadFile(\"{}\"): stale or corrupt, rebuilding.", path.filename().string());
+            return nullptr;
+        }
+        return bvh;
+    }
+
+    void BVHCache::SaveFile(std::filesystem::path const & path, Key const & key, BVH const & bvh) {
+        Engine::TraceScope const trace("SaveBLAS", "build", path);
+        // write to a private temporary and rename it, so that concurrent runs never see a partial file.
+        std::error_code             ec;
+        std::filesystem::path const tmp = path.string() + fmt::format(".{:08x}.tmp", std::random_device()());
+        std::filesystem::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            WriteRaw(out, c_BVHFileMagic);
+            WriteRaw(out, c_BVHFileVersion);
+            WriteRaw(out, std::uint32_t(sizeof(BVHNode)));
+            WriteRaw(out, std::uint32_t(sizeof(WideBVHNode)));
+            WriteRaw(out, std::uint32_t(sizeof(WideTriangleBlock)));
+            WriteRaw(out, std::get<0>(key));
+            WriteRaw(out, std::get<1>(key));
+            WriteRaw(out, std::get<2>(key));
+            bvh.Write(out);
+            if (! out.flush()) ec = std::make_error_code(std::errc::io_error);
+        }
+        if (! ec) std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            spdlog::warn("VCX::Labs::Rendering::BVHCache::SaveFile(\"{}\"): {}.", path.filename().string(), ec.message());
+            std::filesystem::remove(tmp, ec);
+        }
+    }
+
+    std::shared_ptr<BVH const> BVHCache::Acquire(Engine::SurfaceMesh const & mesh, BVHBuildOptions const & options, bool & built, std::filesystem::path const & directory) {
+        Key const key { HashMesh(mesh), mesh.Positions.size(), mesh.Indices.size(), options.Layout, options.Builder, options.NumBins, options.MaxLeafSize, options.TraversalCost, options.IntersectionCost };
+        {
+            std::lock_guard lock(_mutex);
+            if (auto const iter = _entries.find(key); iter != _entries.end()) {
+                built = false;
+                return iter->second;
+            }
+        }
+        // load or build outside the lock so that intersectors of different cases do not wait for each other.
+        std::filesystem::path const path = directory.empty() ? std::filesystem::path() : GetFilePath(directory, key);
+        std::shared_ptr<BVH>        bvh  = path.empty() ? nullptr : LoadFile(path, key);
+        built                            = ! bvh;
+        if (built) {
+            Engine::TraceScope trace("BuildBLAS", "build");
+            trace.AddArg("triangles", std::int64_t(mesh.Indices.size() / 3));
+            bvh = std::make_shared<BVH>();
+            bvh->Build(mesh, options);
+            if (! path.empty()) SaveFile(path, key, *bvh);
+        }
+        std::lock_guard lock(_mutex);
+        return _entries.try_emplace(key, std::move(bvh)).first->second;
+    }
+
+    void BVHCache::Clear() {
+        std::lock_guard lock(_mutex);
+        _entries.clear();
+    }
+
+    void TwoLevelBVH::Build(Engine::Scene const & scene, BVHBuildOptions const & options, std::filesystem::path const & cacheDirectory, BVHCache & cache) {
+        Engine::TraceScope const trace("BuildBVH", "build");
+        auto const               start = std::chrono::steady_clock::now();
+        Clear();
+
+        // models are handed out to the workers one at a time, large meshes additionally split their own build.
+        std::vector<std::shared_ptr<BVH const>> blases(scene.Models.size());
+        std::atomic<std::size_t>                nextModel { 0 };
+        std::atomic<std::size_t>                numBuilt { 0 };
+        auto const                              BuildModels = [&]() {
+            for (std::size_t i; (i = nextModel.fetch_add(1)) < scene.Models.size();) {
+                bool built;
+                blases[i] = cache.Acquire(scene.Models[i].Mesh, options, built, cacheDirectory);
+                numBuilt += built;
+            }
+        };
+        Engine::TaskGroup workers(GetBuildPool());
+        for (std::size_t t = 1; t < std::min(GetBuildThreadCount(options), scene.Models.size()); ++t)
+            workers.Run(BuildModels);
+        BuildModels();
+        workers.Wait();
+
+        std::vector<BVHInstance>    instances;
+        std::vector<BuildPrimitive> prims;
+        for (std::size_t i = 0; i < scene.Models.size(); ++i) {
+            auto & blas = blases[i];
+            if (blas->IsEmpty()) continue;
+            prims.push_back({ .Bounds = blas->GetBounds(), .Centroid = blas->GetBounds().GetCenter(), .Index = std::uint32_t(instances.size()) });
+            instances.push_back({ std::move(blas), std::uint32_t(i) });
+        }
+        if (instances.empty()) return;
+
+        // an instance test is a whole bottom-level traversal, so top-level leaves hold a single instance.
+        BVHBuildOptions topOptions = options;
+        topOptions.MaxLeafSize     = 1;
+        BuildNodes(prims, topOptions, _nodes, _statistics);
+        std::size_t const topDepth = _statistics.MaxDepth;
+        _statistics.NodeBytes      = _nodes.size() * sizeof(BVHNode) + instances.size() * sizeof(BVHInstance);
+
+        _instances.resize(instances.size());
+        for (std::size_t i = 0; i < prims.size(); ++i)
+            _instances[i] = std::move(instances[prims[i].Index]);
+
+        float const invRootArea = 1.f / std::max(_nodes[0].Bounds.GetSurfaceArea(), std::numeric_limits<float>::min());
+        for (auto const & node : _nodes) {
+            if (node.Count == 0) _statistics.SAHCost += node.Bounds.GetSurfaceArea() * invRootArea * options.TraversalCost;
+        }
+        for (auto const & instance : _instances) {
+            auto const & stats = instance.BLAS->GetStatistics();
+            _statistics.NumTriangles += stats.NumTriangles;
+            _statistics.NumReferences += stats.NumReferences;
+            _statistics.NumNodes += stats.NumNodes;
+            _statistics.NumLeaves += stats.NumLeaves;
+            _statistics.NodeBytes += stats.NodeBytes;
+            _statistics.PrimitiveBytes += stats.PrimitiveBytes;
+            _statistics.MaxDepth = std::max(_statistics.MaxDepth, topDepth + 1 + stats.MaxDepth);
+            _statistics.SAHCost += stats.SAHCost * instance.BLAS->GetBounds().GetSurfaceArea() * invRootArea;
+        }
+        _statistics.BuildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        spdlog::info(
+            "VCX::Labs::Rendering::TwoLevelBVH::Build(..): {} models ({} built, {} cached), {} triangles, {} nodes, depth {}, SAH cost {:.2f}, {:.1f} ms.",
+            _instances.size(),
+            numBuilt.load(),
+            scene.Models.size() - numBuilt.load(),
+            _statistics.NumTriangles,
+            _statistics.NumNodes,
+            _statistics.MaxDepth,
+            _statistics.SAHCost,
+            _statistics.BuildTime);
+    }
+
+    void TwoLevelBVH::Clear() {
+        _nodes.clear();
+        _instances.clear();
+        _statistics = AccelStatistics();
+    }
+
+    bool TwoLevelBVH::Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const {
+        glm::vec3 const invDir = 1.f / glm::normalize(ray.Direction);
+        float           tBest  = tMax;
+        bool            found  = false;
+        Traverse(_nodes, ray.Origin, invDir, tMin, tBest, [&](std::uint32_t const offset, std::uint32_t const count) {
+            for (std::uint32_t k = offset; k < offset + count; ++k) {
+                if (! _instances[k].BLAS->Intersect(ray, tMin, tBest, hit)) continue;
+                tBest          = hit.T;
+                hit.ModelIndex = _instances[k].ModelIndex;
+                found          = true;
+            }
+            return false;
+        });
+        return found;
+    }
+
+    bool TwoLevelBVH::Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter) const {
+        // bottom-level hits do not know their model, so a filter is wrapped to fill it in.
+        struct InstanceFilter {
+            AnyHitFilter const & Filter;
+            std::uint32_t        ModelIndex;
+        };
+        auto const AcceptInstance = [](void const * context, AccelHit const & hit) {
+            auto const & instance = *static_cast<InstanceFilter const *>(context);
+            AccelHit     modelHit = hit;
+            modelHit.ModelIndex   = instance.ModelIndex;
+            return instance.Filter(modelHit);
+        };
+        glm::vec3 const invDir   = 1.f / glm::normalize(ray.Direction);
+        float           tBest    = tMax;
+        bool            occluded = false;
+        Traverse(_nodes, ray.Origin, invDir, tMin, tBest, [&](std::uint32_t const offset, std::uint32_t const count) {
+            for (std::uint32_t k = offset; k < offset + count; ++k) {
+                InstanceFilter const context { filter, _instances[k].ModelIndex };
+                AnyHitFilter const   instanceFilter { filter.Accept ? +AcceptInstance : nullptr, &context };
+                if (_instances[k].BLAS->Occluded(ray, tMin, tMax, instanceFilter)) return occluded = true;
+            }
+            return false;
+        });
+        return occluded;
+    }
+
+} // namespace VCX::Labs::Rendering
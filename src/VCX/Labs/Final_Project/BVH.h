@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "Engine/Scene.h"
+#include "Labs/Final_Project/Accel.h"
+#include "Labs/Final_Project/Ray.h"
+#include "Labs/Final_Project/WideBVH.h"
+
+namespace VCX::Labs::Rendering {
+
+    enum class BVHLayout {
+        Binary,
+        Wide8,          // binary tree collapsed into 8-wide nodes, see WideBVH
+        Wide8Quantized, // as Wide8, with 8-bit child bounds in 128-byte nodes
+    };
+
+    enum class BVHBuilder {
+        BinnedSAH,
+        Morton, // LBVH, much faster to build but gives a higher SAH cost
+    };
+
+    struct BVHBuildOptions {
+        BVHLayout  Layout           { BVHLayout::Wide8 };
+        BVHBuilder Builder          { BVHBuilder::BinnedSAH };
+        int        NumThreads       { 0 }; // 0 uses every hardware thread
+        int        NumBins          { 16 };
+        int        MaxLeafSize      { 4 };
+        float      TraversalCost    { 1.f };
+        float      IntersectionCost { 1.f };
+
+        bool operator==(BVHBuildOptions const &) const = default;
+    };
+
+    // bottom-level hierarchy over the triangles of a single mesh.
+    class BVH {
+    public:
+        void Build(Engine::SurfaceMesh const & mesh, BVHBuildOptions const & options = { });
+        void Clear();
+
+        void Write(std::ostream & out) const;
+        bool Read(std::istream & in);
+
+        bool IsEmpty() const { return _bounds.IsEmpty(); }
+        AABB GetBounds() const { return _bounds; }
+
+        // closest hit with t in [tMin, tMax], t is measured along the normalized ray direction.
+        // AccelHit::ModelIndex is left untouched since the same hierarchy may be shared by several models.
+        bool Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const;
+
+        // whether any hit with t in [tMin, tMax] passes filter, stops at the first one. the filter sees ModelIndex 0.
+        bool Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter = { }) const;
+
+        AccelStatistics const & GetStatistics() const { return _statistics; }
+
+    private:
+        AABB                       _bounds;
+        std::vector<BVHNode>       _nodes;     // empty unless the layout is binary
+        std::vector<AccelTriangle> _triangles; // empty unless the layout is binary
+        WideBVH                    _wide;
+        AccelStatistics            _statistics;
+    };
+
+    // bottom-level hierarchies shared by all intersectors, keyed by mesh content so that
+    // switching scenes or appending models only builds the meshes that were never seen.
+    // with a non-empty directory, hierarchies also persist there across runs, one file per key.
+    class BVHCache {
+    public:
+        static BVHCache & Get();
+
+        std::shared_ptr<BVH const> Acquire(Engine::SurfaceMesh const & mesh, BVHBuildOptions const & options, bool & built, std::filesystem::path const & directory = { });
+        void                       Clear();
+
+    private:
+        using Key = std::tuple<std::uint64_t, std::size_t, std::size_t, BVHLayout, BVHBuilder, int, int, float, float>;
+
+        static std::filesystem::path GetFilePath(std::filesystem::path const & directory, Key const & key);
+        static std::shared_ptr<BVH>  LoadFile(std::filesystem::path const & path, Key const & key);
+        static void                  SaveFile(std::filesystem::path const & path, Key const & key, BVH const & bvh);
+
+        std::mutex                                _mutex;
+        std::map<Key, std::shared_ptr<BVH const>> _entries;
+    };
+
+    struct BVHInstance {
+        std::shared_ptr<BVH const> BLAS;
+        std::uint32_t              ModelIndex;
+    };
+
+    // top-level hierarchy over the bounds of every Engine::Model, each referencing a cached BVH.
+    class TwoLevelBVH {
+    public:
+        // the bottom-level hierarchies come from cache, cacheDirectory is forwarded to BVHCache::Acquire(..).
+        void Build(Engine::Scene const & scene, BVHBuildOptions const & options = { }, std::filesystem::path const & cacheDirectory = { }, BVHCache & cache = BVHCache::Get());
+        void Clear();
+
+        bool IsEmpty() const { return _nodes.empty(); }
+
+        // closest hit with t in [tMin, tMax], t is measured along the normalized ray direction.
+        bool Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const;
+
+        // whether any hit with t in [tMin, tMax] passes filter, stops at the first one.
+        bool Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter = { }) const;
+
+        AccelStatistics const & GetStatistics() const { return _statistics; }
+
+    private:
+        std::vector<BVHNode>     _nodes;
+        std::vector<BVHInstance> _instances; // in leaf order
+        AccelStatistics          _statistics;
+    };
+
+} // namespace VCX::Labs::Rendering
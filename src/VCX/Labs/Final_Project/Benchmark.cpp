@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include <spdlog/spdlog.h>
+
+#include "Labs/Final_Project/Benchmark.h"
+#include "Labs/Final_Project/tasks.h"
+
+namespace VCX::Labs::Rendering {
+
+    static char const * const c_LayoutNames[] = { "binary", "8-wide", "8-wide quantized" };
+
+    // returns million rays per second.
+    static double TraceRays(TwoLevelBVH const & bvh, std::vector<Ray> const & rays) {
+        auto const start = std::chrono::steady_clock::now();
+        for (auto const & ray : rays) {
+            AccelHit hit;
+            bvh.Intersect(ray, EPS1, 1e7, hit);
+        }
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return rays.size() * 1e-6 / std::max(seconds, 1e-9);
+    }
+
+    // rays in uniformly distributed directions from the hits of rays, with a fixed seed.
+    static std::vector<Ray> GenerateSecondaryRays(TwoLevelBVH const & bvh, std::vector<Ray> const & rays) {
+        std::vector<Ray>                secondaryRays;
+        std::mt19937                    generator(0);
+        std::normal_distribution<float> normal;
+        for (auto const & ray : rays) {
+            AccelHit hit;
+            if (! bvh.Intersect(ray, EPS1, 1e7, hit)) continue;
+            secondaryRays.emplace_back(ray.Origin + hit.T * glm::normalize(ray.Direction), glm::vec3(normal(generator), normal(generator), normal(generator)));
+        }
+        return secondaryRays;
+    }
+
+    std::vector<BVHLayoutBenchmark> BenchmarkBVHLayouts(Engine::Scene const & scene, Engine::Camera const & camera, BVHBuildOptions options, std::uint32_t const resolution) {
+        // camera rays as the renderers generate them, on a square image.
+        std::vector<Ray> primaryRays;
+        glm::vec3 const  lookDir   = glm::normalize(camera.Target - camera.Eye);
+        glm::vec3 const  rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+        glm::vec3 const  upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+        float const      fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+        primaryRays.reserve(std::size_t(resolution) * resolution);
+        for (std::uint32_t j = 0; j < resolution; ++j)
+            for (std::uint32_t i = 0; i < resolution; ++i) {
+                glm::vec3 dir = lookDir;
+                dir += fovFactor * (2.0f * (j + .5f) / resolution - 1.0f) * upDir;
+                dir += fovFactor * (2.0f * (i + .5f) / resolution - 1.0f) * rightDir;
+                primaryRays.emplace_back(camera.Eye, glm::normalize(dir));
+            }
+
+        std::vector<BVHLayoutBenchmark> results;
+        std::vector<Ray>                secondaryRays;
+        for (BVHLayout const layout : { BVHLayout::Binary, BVHLayout::Wide8, BVHLayout::Wide8Quantized }) {
+            options.Layout = layout;
+            // a private cache, so that every layout is built from scratch and the shared one is left alone.
+            BVHCache    cache;
+            TwoLevelBVH bvh;
+            bvh.Build(scene, options, { }, cache);
+
+            if (secondaryRays.empty()) secondaryRays = GenerateSecondaryRays(bvh, primaryRays);
+            double const primary   = TraceRays(bvh, primaryRays);
+            double const secondary = TraceRays(bvh, secondaryRays);
+
+            auto const & stats = bvh.GetStatistics();
+            results.push_back({ layout, stats.NodeBytes, stats.PrimitiveBytes, stats.BuildTime, primary, secondary });
+            spdlog::info(
+                "VCX::Labs::Rendering::BenchmarkBVHLayouts(..): {}, nodes {:.2f} MB, triangles {:.2f} MB, build {:.1f} ms, primary {:.3f} Mrays/s, secondary {:.3f} Mrays/s.",
+                c_LayoutNames[int(layout)],
+                stats.NodeBytes / 1048576.,
+                stats.PrimitiveBytes / 1048576.,
+                stats.BuildTime,
+                primary,
+                secondary);
+        }
+        return results;
+    }
+
+} // namespace VCX::Labs::Rendering
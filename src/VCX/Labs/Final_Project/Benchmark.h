@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Engine/Scene.h"
+#include "Labs/Final_Project/BVH.h"
+
+namespace VCX::Labs::Rendering {
+
+    struct BVHLayoutBenchmark {
+        BVHLayout   Layout;
+        std::size_t NodeBytes;
+        std::size_t PrimitiveBytes;
+        double      BuildTime;      // in milliseconds
+        double      PrimaryMRays;   // coherent camera rays, million rays per second on one thread
+        double      SecondaryMRays; // incoherent rays leaving the primary hits
+    };
+
+    // builds every BVH layout over scene and traces the same rays through each of them, the results are also logged.
+    // each layout is built into a private BVHCache so that build times are comparable, BVHCache::Get() is not touched.
+    // only reads scene, so it may run on a worker while the scene is not modified.
+    std::vector<BVHLayoutBenchmark> BenchmarkBVHLayouts(Engine::Scene const & scene, Engine::Camera const & camera, BVHBuildOptions options, std::uint32_t const resolution = 512);
+
+} // namespace VCX::Labs::Rendering
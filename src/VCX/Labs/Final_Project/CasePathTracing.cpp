@@ -1,3 +1,11 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <fmt/core.h>
+
+#include "Engine/Trace.h"
 #include "Labs/Final_Project/CasePathTracing.h"
 
 namespace VCX::Labs::Rendering {
@@ -7,14 +15,31 @@ namespace VCX::Labs::Rendering {
         _program(
             Engine::GL::UniqueProgram({ Engine::GL::SharedShader("assets/shaders/flat.vert"), Engine::GL::SharedShader("assets/shaders/flat.frag") })),
         _sceneObject(4),
-        _texture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Nearest }) {
+        _texture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Nearest }),
+        _previewTexture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Linear }) {
         _cameraManager.AutoRotate = false;
         _program.GetUniforms().SetByName("u_Color", glm::vec3(0, 0, 0));
+        Common::RenderScheduler::Get().Register(
+            this,
+            [this]() {
+                // stopped as if by the user, but resumed as soon as the case is back on screen.
+                _preview.Cancel();
+                if (! _task.IsValid() || _stopFlag) return;
+                _stopFlag = true;
+                _task.Cancel();
+                _suspended = true;
+            },
+            [this]() {
+                if (_suspended) _stopFlag = false;
+                _suspended = false;
+            });
     }
 
     CasePathTracing::~CasePathTracing() {
-        _stopFlag = true;
-        if (_task.joinable()) _task.join();
+        Common::RenderScheduler::Get().Unregister(this);
+        _task.Cancel();
+        _task.Wait();
+        _benchmark.Wait();
     }
 
     void CasePathTracing::OnSetupPropsUI() {
@@ -25,7 +50,6 @@ namespace VCX::Labs::Rendering {
                     if (! selected) {
                         _sceneIdx   = i;
                         _sceneDirty = true;
-                        _treeDirty  = true;
                         _resetDirty = true;
                     }
                 }
@@ -34,37 +58,194 @@ namespace VCX::Labs::Rendering {
         }
         if (ImGui::Button("Reset Scene")) _resetDirty = true;
         ImGui::SameLine();
-        if (_task.joinable()) {
+        if (! _stopFlag) {
             if (ImGui::Button("Stop Rendering")) {
                 _stopFlag = true;
-                if (_task.joinable()) _task.join();
+                _task.Cancel();
             }
         } else if (ImGui::Button("Start Rendering")) _stopFlag = false;
-        ImGui::ProgressBar(float(_pixelIndex) / (_buffer.GetSizeX() * _buffer.GetSizeY()));
+        auto const [width, height] = GetBufferSize();
+
+        std::size_t const numPixels = std::max<std::size_t>(std::size_t(width) * height, 1);
+        float const       spp       = float(_totalSamples) / numPixels;
+        std::string       overlay   = _samplesPerPixel > 0 ? fmt::format("{:.1f} / {} spp", spp, _samplesPerPixel) : fmt::format("{:.1f} spp", spp);
+        float             progress  = _samplesPerPixel > 0 ? spp / _samplesPerPixel : _renderer.GetProgress();
+        if (_adaptive && _numPasses > 0) {
+            // converged pixels count as done, so the bar tracks the pixels that still receive samples.
+            overlay += fmt::format(", {:.0f}% active", 100. * _numActive / numPixels);
+            progress = std::max(progress, 1.f - float(_numActive) / numPixels);
+        }
+        ImGui::ProgressBar(std::min(progress, 1.f), ImVec2(-1, 0), overlay.c_str());
         Common::ImGuiHelper::SaveImage(_texture, GetBufferSize(), true);
         ImGui::Spacing();
 
         if (ImGui::CollapsingHeader("Appearance", ImGuiTreeNodeFlags_DefaultOpen)) {
-            _resetDirty |= ImGui::SliderInt("Samples per Pixel", &_samplesPerPixel, 1, 100);
+            _resetDirty |= ImGui::SliderInt("Samples per Pixel", &_samplesPerPixel, 0, 1024, _samplesPerPixel ? "%d" : "unlimited");
+            _resetDirty |= ImGui::SliderInt("Samples per Pass", &_samplesPerPass, 1, 16);
+            static char const * const samplerNames[] = { "independent", "Halton", "Sobol (Owen)", "blue noise" };
+            int                       sampler        = int(_samplerType);
+            if (ImGui::Combo("Sampler", &sampler, samplerNames, IM_ARRAYSIZE(samplerNames))) {
+                _samplerType = SamplerType(sampler);
+                _resetDirty  = true;
+            }
+            _resetDirty |= ImGui::Checkbox("Adaptive Sampling", &_adaptive);
+            if (_adaptive) {
+                _resetDirty |= ImGui::SliderFloat("Error Threshold", &_errorThreshold, .001f, .2f, "%.3f");
+                _resetDirty |= ImGui::SliderInt("Min Samples", &_minSamples, 2, 64);
+            }
+            if (ImGui::Checkbox("Show Sample Map", &_showSampleMap)) {
+                _sampleMapDirty = true;
+                _renderer.Invalidate();
+            }
+            bool showCostMap = _showCostMap;
+            if (ImGui::Checkbox("Show Cost Map", &showCostMap)) {
+                _showCostMap    = showCostMap;
+                _costImageDirty = true;
+                _sampleMapDirty = true;
+                _renderer.Invalidate();
+                // a running render task publishes after its next pass.
+                if (showCostMap && ! _task.IsValid()) PublishCostMap();
+            }
+            if (showCostMap) {
+                static char const * const metricNames[] = { "time", "traversal steps" };
+                int                       metric        = int(_costMetric.load());
+                if (ImGui::Combo("Cost Metric", &metric, metricNames, IM_ARRAYSIZE(metricNames))) {
+                    _costMetric = CostMetric(metric);
+                    if (! _task.IsValid()) PublishCostMap();
+                }
+                if (_costScale > 0)
+                    ImGui::Text(_costMetric == CostMetric::Time ? "White: %.2f us per sample" : "White: %.0f steps per sample", _costScale.load());
+            }
             _resetDirty |= ImGui::SliderInt("Max Depth", &_maximumDepth, 1, 20);
         }
         ImGui::Spacing();
 
         if (ImGui::CollapsingHeader("Control")) {
             ImGui::Checkbox("Zoom Tooltip", &_enableZoom);
+            if (ImGui::Checkbox("Ray-Traced Preview", &_enablePreview) && ! _enablePreview) {
+                _preview.Cancel();
+                _previewReady = false;
+            }
+            ImGui::SliderInt("Threads", &_numThreads, 0, int(std::max(1u, std::thread::hardware_concurrency())), _numThreads ? "%d" : "auto");
+            _resetDirty |= ImGui::SliderInt("Tile Size", &_tileSize, 8, 128);
+            static char const * const orderNames[] = { "scanline", "Morton", "Hilbert" };
+            int                       order        = int(_traversalOrder);
+            if (ImGui::Combo("Traversal Order", &order, orderNames, IM_ARRAYSIZE(orderNames))) {
+                _traversalOrder = TraversalOrder(order);
+                _resetDirty     = true;
+            }
+            static char const * const structureNames[] = { "BVH", "kd-tree" };
+            int                       structure        = int(_intersectorOptions.Structure);
+            if (ImGui::Combo("Accelerator", &structure, structureNames, IM_ARRAYSIZE(structureNames))) {
+                _intersectorOptions.Structure = AccelerationStructure(structure);
+                _resetDirty                   = true;
+            }
+            if (_intersectorOptions.Structure == AccelerationStructure::BVH) {
+                static char const * const layoutNames[] = { "binary", "8-wide", "8-wide quantized" };
+                int                       layout        = int(_intersectorOptions.BVHOptions.Layout);
+                if (ImGui::Combo("BVH Layout", &layout, layoutNames, IM_ARRAYSIZE(layoutNames))) {
+                    _intersectorOptions.BVHOptions.Layout = BVHLayout(layout);
+                    _resetDirty                           = true;
+                }
+                static char const * const builderNames[] = { "binned SAH", "Morton" };
+                int                       builder        = int(_intersectorOptions.BVHOptions.Builder);
+                if (ImGui::Combo("BVH Builder", &builder, builderNames, IM_ARRAYSIZE(builderNames))) {
+                    _intersectorOptions.BVHOptions.Builder = BVHBuilder(builder);
+                    _resetDirty                            = true;
+                }
+                bool avx2 = WideBVH::IsAVX2Enabled();
+                if (_intersectorOptions.BVHOptions.Layout != BVHLayout::Binary && WideBVH::IsAVX2Supported() && ImGui::Checkbox("AVX2", &avx2)) {
+                    WideBVH::SetAVX2Enabled(avx2);
+                    _resetDirty = true;
+                }
+                if (IsBenchmarking()) ImGui::Text("Benchmarking...");
+                else if (ImGui::Button("Benchmark Layouts")) {
+                    // the render loop and the preview stay stopped so that they do not skew the timings.
+                    _stopFlag = true;
+                    _task.Cancel();
+                    _preview.Cancel();
+                    _benchmark = Common::RenderScheduler::Get().Submit<std::vector<BVHLayoutBenchmark>>(
+                        this, [this, &scene = GetScene(_sceneIdx), camera = _sceneObject.Camera, options = _intersectorOptions.BVHOptions]() {
+                            // waits here rather than on the UI thread for a build the preview already started.
+                            _preview.Stop();
+                            return BenchmarkBVHLayouts(scene, camera, options);
+                        });
+                }
+                if (_benchmark.HasValue())
+                    for (auto const & result : _benchmark.Value())
+                        ImGui::Text(
+                            "%s: %.1f + %.1f MB, %.2f / %.2f Mrays/s",
+                            layoutNames[int(result.Layout)],
+                            result.NodeBytes / 1048576.,
+                            result.PrimitiveBytes / 1048576.,
+                            result.PrimaryMRays,
+                            result.SecondaryMRays);
+            }
+            if (_intersectorOptions.Structure == AccelerationStructure::KdTree) {
+                auto & options = _intersectorOptions.KdTreeOptions;
+                _resetDirty |= ImGui::SliderFloat("Traversal Cost", &options.TraversalCost, .1f, 10.f);
+                _resetDirty |= ImGui::SliderFloat("Intersection Cost", &options.IntersectionCost, 1.f, 200.f);
+                _resetDirty |= ImGui::SliderInt("Max Tree Depth", &options.MaxDepth, 0, 40, options.MaxDepth ? "%d" : "auto");
+            }
+            AccelStatistics stats;
+            {
+                std::lock_guard lock(_builtStatisticsMutex);
+                stats = _builtStatistics;
+            }
+            ImGui::Text("Tree: %zu nodes, %zu refs, depth %zu", stats.NumNodes, stats.NumReferences, stats.MaxDepth);
+            ImGui::Text("Build: %.1f ms, SAH cost %.2f", stats.BuildTime, stats.SAHCost);
+            ImGui::Text("Memory: %.1f MB nodes, %.1f MB triangles", stats.NodeBytes / 1048576., stats.PrimitiveBytes / 1048576.);
+            if (_renderTime > 0)
+                ImGui::Text("Trace: %.2f s, %.3f Mrays/s", _renderTime.load(), _intersector.GetRayCount() * 1e-6 / _renderTime);
+            auto const &    rayStats = _intersector.GetRayStatistics();
+            RayCounts const counts   = rayStats.Gather();
+            if (counts.GetRays() > 0) {
+                double const rays = double(counts.GetRays());
+                ImGui::Text("Rays: %.2fM camera, %.2fM bounce, %.2fM shadow", counts.CameraRays * 1e-6, counts.BounceRays * 1e-6, counts.ShadowRays * 1e-6);
+                ImGui::Text("Per Ray: %.1f nodes, %.1f triangles", counts.NodesVisited / rays, counts.TrianglesTested / rays);
+                ImGui::Text("Paths: %.2f vertices on average, %.1f%% ended by roulette", counts.GetAveragePathLength(), 100. * counts.RouletteTerminations / std::max<std::uint64_t>(counts.Paths, 1));
+            }
+            if (rayStats.GetNumPasses() > 0)
+                ImGui::Text("Passes: %d, last %.1f ms, average %.1f ms", rayStats.GetNumPasses(), rayStats.GetLastPassTime() * 1e3, rayStats.GetPassTime() * 1e3 / rayStats.GetNumPasses());
+            static char statisticsPath[128] = "ray-statistics.json";
+            if (ImGui::Button("Save Statistics")) WriteRayStatistics(statisticsPath, rayStats);
+            ImGui::SameLine();
+            ImGui::InputText("##statistics", statisticsPath, IM_ARRAYSIZE(statisticsPath));
+            // the tracer is process-wide, so both cases show the same recording.
+            static char tracePath[128] = "trace.json";
+            bool        tracing        = Engine::Tracer::Get().IsEnabled();
+            if (ImGui::Checkbox("Record Trace", &tracing)) {
+                if (tracing) Engine::Tracer::Get().Start();
+                else Engine::Tracer::Get().Stop(tracePath);
+            }
+            ImGui::SameLine();
+            ImGui::InputText("##trace", tracePath, IM_ARRAYSIZE(tracePath));
         }
         ImGui::Spacing();
     }
 
     Common::CaseRenderResult CasePathTracing::OnRender(std::pair<std::uint32_t, std::uint32_t> const desiredSize) {
+        // a cancelled task is only let go once it returned, until then it still touches the renderer and the buffer.
+        if (_task.IsCompleted()) {
+            if (! _task.IsCancelled()) _stopFlag = true; // finished, or failed
+            _task.Reset();
+        }
         if (_resetDirty) {
             _stopFlag = true;
-            if (_task.joinable()) _task.join();
-            _pixelIndex = 0;
-            _resizable  = true;
-            _resetDirty = false;
+            _task.Cancel();
+            _preview.Cancel();
+            _previewReady = false;
+        }
+        // rather than blocking the UI thread, the reset waits for the first frame without a task.
+        if (_resetDirty && ! _task.IsValid()) {
+            _renderer.Reset();
+            _numPasses    = 0;
+            _numActive    = 0;
+            _totalSamples = 0;
+            _resizable    = true;
+            _resetDirty   = false;
         }
-        if (_sceneDirty) {
+        if (_sceneDirty && ! _resetDirty) {
             _sceneObject.ReplaceScene(GetScene(_sceneIdx));
             _cameraManager.Save(_sceneObject.Camera);
             _sceneDirty = false;
@@ -83,72 +264,222 @@ namespace VCX::Labs::Rendering {
                 model.Mesh.Draw({ _program.Use() });
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
             glDisable(GL_DEPTH_TEST);
+
+            if (_enablePreview && _stopFlag && ! _task.IsValid() && ! IsBenchmarking()) {
+                Settings const settings = GetSettings();
+                _preview.Request(
+                    _sceneObject.Camera,
+                    desiredSize,
+                    { .NumThreads = _numThreads, .TileSize = 16, .Order = _traversalOrder },
+                    [this, settings]() { PrepareScene(settings); },
+                    [this, settings](Ray const & ray, std::size_t const x, std::size_t const y) {
+                        // a single path per pixel, drawn after the jitter dimension the final render would use.
+                        Sampler sampler(settings.Sampler, std::uint32_t(x), std::uint32_t(y), 0);
+                        sampler.Get2D();
+                        return PathTrace(_intersector, ray, settings.MaximumDepth, sampler);
+                    });
+                _preview.SyncImage([&](Common::ImageRGB const & image) {
+                    _previewTexture.Update(image);
+                    _previewReady = true;
+                });
+            }
         }
-        if (! _stopFlag && ! _task.joinable()) {
-            if (_pixelIndex == 0) {
+        if (! _stopFlag && ! _task.IsValid()) {
+            if (_numPasses == 0 && _renderer.GetFinishedPixels() == 0) {
+                _renderer.Reset();
                 _resizable = false;
                 _buffer    = _frame.GetColorAttachment().Download<Engine::Formats::RGB8>();
             }
-            _task = std::thread([&]() {
-                auto const width  = _buffer.GetSizeX();
-                auto const height = _buffer.GetSizeY();
-                if (_pixelIndex == 0 && _treeDirty) {
-                    Engine::Scene const & scene = GetScene(_sceneIdx);
-                    _intersector.InitScene(&scene);
-                    _treeDirty = false;
+            // the thread count takes effect whenever rendering (re)starts, the tile size on reset.
+            _renderer.Options = { .NumThreads = _numThreads, .TileSize = _tileSize, .Order = _traversalOrder };
+
+            _task = Common::RenderScheduler::Get().Submit<bool>(this, [&, settings = GetSettings()](Engine::CancellationToken const & token) {
+                auto const        width       = _buffer.GetSizeX();
+                auto const        height      = _buffer.GetSizeY();
+                bool const        fresh       = _numPasses == 0 && _renderer.GetFinishedPixels() == 0;
+                SamplerType const samplerType = settings.Sampler;
+                // the preview shares the intersector, it has to be idle before the tree may be rebuilt. waiting here
+                // rather than on the UI thread lets a build the preview already started finish in the background.
+                _preview.Stop();
+                PrepareScene(settings);
+                if (fresh) {
+                    _intersector.ResetRayStatistics();
+                    _renderTime = 0;
+                    _passStart  = 0;
+                    _estimates.assign(width * height, PixelEstimate());
+                    _passSamples.assign(width * height, 0);
+                    _totalSamples = 0;
+                    _costMap.Reset(width, height);
+                    if (samplerType == SamplerType::BlueNoise) Sampler::LoadBlueNoise();
                 }
-                // Render into tex.
-                int sqrt_samples        = (int) std::sqrt(_samplesPerPixel);
-                int samples_per_stratum = _samplesPerPixel / (sqrt_samples * sqrt_samples);
-                if (samples_per_stratum == 0) samples_per_stratum = 1;
-                int sampleIndex = 0; // For Halton sequence
-                while (_pixelIndex < std::size_t(width) * height) {
-                    int       i = _pixelIndex % width;
-                    int       j = _pixelIndex / width;
-                    glm::vec3 sum(0.0f);
-                    for (int sy = 0; sy < sqrt_samples; ++sy) {
-                        for (int sx = 0; sx < sqrt_samples; ++sx) {
-                            for (int k = 0; k < samples_per_stratum; ++k) {
-                                // Use Halton sequence for better sampling
-                                float        stratum_u = (sx + halton(sampleIndex++, 2)) / sqrt_samples;
-                                float        stratum_v = (sy + halton(sampleIndex++, 3)) / sqrt_samples;
-                                float        di        = stratum_u;
-                                float        dj        = stratum_v;
-                                auto const & camera    = _sceneObject.Camera;
-                                glm::vec3    lookDir   = glm::normalize(camera.Target - camera.Eye);
-                                glm::vec3    rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
-                                glm::vec3    upDir     = glm::normalize(glm::cross(rightDir, lookDir));
-                                float const  aspect    = width * 1.f / height;
-                                float const  fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
-                                lookDir += fovFactor * (2.0f * (j + dj) / height - 1.0f) * upDir;
-                                lookDir += fovFactor * aspect * (2.0f * (i + di) / width - 1.0f) * rightDir;
-                                Ray       initialRay(camera.Eye, glm::normalize(lookDir));
-                                glm::vec3 res = PathTrace(_intersector, initialRay, _maximumDepth, _samplesPerPixel, sampleIndex);
-                                sum += res;
-                            }
-                        }
+                auto const start          = std::chrono::steady_clock::now();
+                auto const GetTime = [&]() {
+                    return _renderTime + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                };
+                auto const AccumulateTime = [&]() { _renderTime = GetTime(); };
+                // Render into tex, a few samples per pixel at a time so that the running average shows up early.
+                auto const &    camera    = _sceneObject.Camera;
+                glm::vec3 const lookDir   = glm::normalize(camera.Target - camera.Eye);
+                glm::vec3 const rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+                glm::vec3 const upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+                float const     aspect    = width * 1.f / height;
+                float const     fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+                while (true) {
+                    // pick the pixels of this pass and their sample counts once, shade and resolve below have to agree on them.
+                    if (_renderer.GetFinishedPixels() == 0) {
+                        // pixels still sampled have taken every pass so far, so they all continue at the same index.
+                        if (samplerType == SamplerType::Halton) _haltonBatch.Generate(std::uint32_t(_numPasses * settings.SamplesPerPass), settings.SamplesPerPass, 16);
+                        std::size_t numActive = 0;
+                        for (std::size_t k = 0; k < _estimates.size(); ++k)
+                            numActive += (_passSamples[k] = GetPassSamples(_estimates[k], settings)) > 0;
+                        _numActive = numActive;
+                        if (numActive == 0) break;
+                    }
+                    bool const finished = _renderer.Render(
+                        _buffer,
+                        [&](std::size_t const i, std::size_t const j) {
+                            PixelEstimate const & estimate = _estimates[j * width + i];
+                            int const             samples  = _passSamples[j * width + i];
+                            if (samples == 0) return estimate.GetMean();
+                            return _costMap.Measure(i, j, samples, [&]() {
+                                glm::vec3 sum(0.0f);
+                                for (int k = 0; k < samples; ++k) {
+                                    // the sample index continues across passes, so the sequence does too.
+                                    Sampler         sampler(samplerType, std::uint32_t(i), std::uint32_t(j), std::uint32_t(estimate.Samples + k), &_haltonBatch);
+                                    glm::vec2 const jitter = sampler.Get2D();
+                                    glm::vec3       dir    = lookDir;
+                                    dir += fovFactor * (2.0f * (j + jitter.y) / height - 1.0f) * upDir;
+                                    dir += fovFactor * aspect * (2.0f * (i + jitter.x) / width - 1.0f) * rightDir;
+                                    Ray initialRay(camera.Eye, glm::normalize(dir));
+                                    sum += PathTrace(_intersector, initialRay, settings.MaximumDepth, sampler);
+                                }
+                                return sum;
+                            });
+                        },
+                        token,
+                        [&](std::size_t const i, std::size_t const j, glm::vec3 const & value) {
+                            PixelEstimate & estimate = _estimates[j * width + i];
+                            int const       samples  = _passSamples[j * width + i];
+                            if (samples == 0) return value;
+                            float const mean = glm::dot(value, glm::vec3(.2126f, .7152f, .0722f)) / samples;
+                            estimate.Radiance += value;
+                            estimate.LuminanceSq += samples * mean * mean;
+                            estimate.Samples += samples;
+                            estimate.Passes += 1;
+                            _totalSamples.fetch_add(samples, std::memory_order_relaxed);
+                            return estimate.GetMean();
+                        });
+                    if (! finished) {
+                        AccumulateTime();
+                        return false;
+                    }
+                    ++_numPasses;
+                    double const passEnd = GetTime();
+                    _intersector.GetRayStatistics().AddPass(passEnd - _passStart);
+                    _passStart = passEnd;
+                    _renderer.Reset();
+                    PublishSampleMap();
+                    if (_showCostMap) PublishCostMap();
+                    if (token.IsCancelled()) {
+                        AccumulateTime();
+                        return false;
                     }
-                    _buffer.At(i, j) = sum / glm::vec3(_samplesPerPixel);
-                    ++_pixelIndex;
-                    if (_stopFlag) return;
                 }
+                AccumulateTime();
+                spdlog::info(
+                    "VCX::Labs::Rendering::CasePathTracing::OnRender(..): {} rays in {:.2f} s, {:.3f} Mrays/s.",
+                    _intersector.GetRayCount(),
+                    _renderTime.load(),
+                    _intersector.GetRayCount() * 1e-6 / _renderTime);
+                auto const [minSamples, maxSamples] = std::minmax_element(_estimates.begin(), _estimates.end(), [](auto const & a, auto const & b) { return a.Samples < b.Samples; });
+                if (minSamples != _estimates.end())
+                    spdlog::info(
+                        "VCX::Labs::Rendering::CasePathTracing::OnRender(..): {:.1f} spp on average, {} to {} per pixel, {:.1f}% of the samples of a uniform {} spp.",
+                        double(_totalSamples) / _estimates.size(),
+                        minSamples->Samples,
+                        maxSamples->Samples,
+                        100. * _totalSamples / (double(maxSamples->Samples) * _estimates.size()),
+                        maxSamples->Samples);
+                return true;
             });
         }
         if (! _resizable) {
-            if (! _stopFlag) _texture.Update(_buffer);
-            if (_task.joinable() && _pixelIndex == _buffer.GetSizeX() * _buffer.GetSizeY()) {
-                _stopFlag = true;
-                _task.join();
+            if (_showCostMap) {
+                if (_costImageDirty.exchange(false)) {
+                    std::lock_guard lock(_costImageMutex);
+                    if (_costImage.GetSizeX() > 0) _texture.Update(_costImage);
+                }
+            } else if (! _showSampleMap) {
+                _renderer.SyncImage([&]() { _texture.Update(_buffer); });
+            } else if (_sampleMapDirty.exchange(false)) {
+                std::lock_guard lock(_sampleMapMutex);
+                if (_sampleMap.GetSizeX() > 0) _texture.Update(_sampleMap);
             }
         }
         return Common::CaseRenderResult {
             .Fixed     = false,
             .Flipped   = true,
-            .Image     = _resizable ? _frame.GetColorAttachment() : _texture,
+            .Image     = _resizable ? (_enablePreview && _previewReady ? _previewTexture : _frame.GetColorAttachment()) : _texture,
             .ImageSize = _resizable ? desiredSize : GetBufferSize(),
         };
     }
 
+    int CasePathTracing::GetPassSamples(PixelEstimate const & estimate, Settings const & settings) {
+        int const target = settings.SamplesPerPixel;
+        if (target > 0 && estimate.Samples >= target) return 0;
+        if (settings.Adaptive && estimate.Samples >= settings.MinSamples && estimate.GetRelativeError() <= settings.ErrorThreshold) return 0;
+        return target > 0 ? std::min(settings.SamplesPerPass, target - estimate.Samples) : settings.SamplesPerPass;
+    }
+
+    void CasePathTracing::PublishSampleMap() {
+        auto const [width, height] = GetBufferSize();
+
+        int maxSamples = 1;
+        for (auto const & estimate : _estimates) maxSamples = std::max(maxSamples, estimate.Samples);
+        Common::ImageRGB map(width, height);
+        for (std::size_t j = 0; j < height; ++j)
+            for (std::size_t i = 0; i < width; ++i)
+                map.At(i, j) = GetHeatColor(float(_estimates[j * width + i].Samples) / maxSamples);
+        std::lock_guard lock(_sampleMapMutex);
+        _sampleMap      = std::move(map);
+        _sampleMapDirty = true;
+    }
+
+    void CasePathTracing::PublishCostMap() {
+        float            scale;
+        Common::ImageRGB image = _costMap.GetImage(_costMetric, scale);
+        std::lock_guard  lock(_costImageMutex);
+        _costImage      = std::move(image);
+        _costScale      = scale;
+        _costImageDirty = true;
+    }
+
+    CasePathTracing::Settings CasePathTracing::GetSettings() const {
+        IntersectorOptions intersector = _intersectorOptions;
+        intersector.CacheDirectory     = GetSceneCacheDirectory(_sceneIdx);
+        return {
+            .SceneIdx        = _sceneIdx,
+            .Intersector     = std::move(intersector),
+            .MaximumDepth    = _maximumDepth,
+            .Sampler         = _samplerType,
+            .SamplesPerPixel = _samplesPerPixel,
+            .SamplesPerPass  = _samplesPerPass,
+            .Adaptive        = _adaptive,
+            .ErrorThreshold  = _errorThreshold,
+            .MinSamples      = _minSamples,
+        };
+    }
+
+    void CasePathTracing::PrepareScene(Settings const & settings) {
+        if (_builtOptions && _builtSceneIdx == settings.SceneIdx && *_builtOptions == settings.Intersector) return;
+        _intersector.SetOptions(settings.Intersector);
+        _intersector.InitScene(&GetScene(settings.SceneIdx));
+        _builtSceneIdx = settings.SceneIdx;
+        _builtOptions  = settings.Intersector;
+        std::lock_guard lock(_builtStatisticsMutex);
+        _builtStatistics = _intersector.GetStatistics();
+    }
+
     void CasePathTracing::OnProcessInput(ImVec2 const & pos) {
         auto         window  = ImGui::GetCurrentWindow();
         bool         hovered = false;
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <atomic>
 #include <cstdint>
 #include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <optional>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -12,12 +17,35 @@
 #include "Labs/Common/ICase.h"
 #include "Labs/Common/ImageRGB.h"
 #include "Labs/Common/OrbitCameraManager.h"
+#include "Labs/Common/RenderScheduler.h"
+#include "Labs/Final_Project/Benchmark.h"
 #include "Labs/Final_Project/Content.h"
+#include "Labs/Final_Project/CostMap.h"
+#include "Labs/Final_Project/PreviewRenderer.h"
 #include "Labs/Final_Project/SceneObject.h"
+#include "Labs/Final_Project/TileRenderer.h"
 #include "Labs/Final_Project/tasks.h"
 
 namespace VCX::Labs::Rendering {
 
+    // running estimate of one pixel; the luminance variance is taken over the passes, each pass mean weighted by its sample count.
+    struct PixelEstimate {
+        glm::vec3 Radiance { 0 };    // summed over all samples
+        float     LuminanceSq { 0 }; // sum of samples * (pass mean luminance)^2
+        int       Samples { 0 };
+        int       Passes { 0 };
+
+        glm::vec3 GetMean() const { return Samples ? Radiance / float(Samples) : glm::vec3(0); }
+
+        // standard error of the mean luminance relative to the mean, floored so that dark pixels do not chase invisible noise.
+        float GetRelativeError() const {
+            if (Passes < 2) return std::numeric_limits<float>::infinity();
+            float const mean     = glm::dot(GetMean(), glm::vec3(.2126f, .7152f, .0722f));
+            float const variance = std::max(0.f, (LuminanceSq - Samples * mean * mean) / (Passes - 1));
+            return std::sqrt(variance / Samples) / std::max(mean, .05f);
+        }
+    };
+
     class CasePathTracing : public Common::ICase {
     public:
         CasePathTracing(std::initializer_list<Assets::ExampleScene> && scenes);
@@ -37,25 +65,99 @@ namespace VCX::Labs::Rendering {
         Common::OrbitCameraManager              _cameraManager;
 
         Engine::GL::UniqueTexture2D _texture;
+        Engine::GL::UniqueTexture2D _previewTexture;
         RayIntersector              _intersector;
+        IntersectorOptions          _intersectorOptions; // edited by the UI, the tracing threads get theirs through Settings
+
+        // what _intersector was last built from, only touched by PrepareScene(..).
+        std::size_t                       _builtSceneIdx { 0 };
+        std::optional<IntersectorOptions> _builtOptions;
+        AccelStatistics                   _builtStatistics; // of _intersector, copied for the UI once a build finishes
+        std::mutex                        _builtStatisticsMutex;
 
         std::size_t      _sceneIdx { 0 };
         bool             _enableZoom { true };
         int              _maximumDepth { 5 };
-        int              _samplesPerPixel { 10 };
-        std::size_t      _pixelIndex { 0 };
-        bool             _stopFlag { true };
+        int              _samplesPerPixel { 64 }; // target, 0 keeps refining until stopped
+        int              _samplesPerPass { 1 };
+        SamplerType      _samplerType { SamplerType::Sobol };
         bool             _sceneDirty { true };
-        bool             _treeDirty { true };
         bool             _resetDirty { true };
         Common::ImageRGB _buffer;
         bool             _resizable { true };
 
-        std::thread _task;
+        std::atomic<double> _renderTime { 0 };  // seconds spent tracing the current image
+        double              _passStart { 0 };   // _renderTime when the current pass began, only touched by the render task
+        bool                _stopFlag { true }; // UI thread only, the render task polls the token of _task
+
+        bool  _adaptive { false };
+        float _errorThreshold { .02f }; // relative error below which a pixel stops receiving samples
+        int   _minSamples { 8 };        // per pixel before its error is trusted
+
+        std::vector<PixelEstimate> _estimates; // row by row
+        std::vector<int>           _passSamples; // samples each pixel takes in the current pass, 0 once it is done
+        std::atomic<int>           _numPasses { 0 };
+        std::atomic<std::size_t>   _numActive { 0 };
+        std::atomic<std::uint64_t> _totalSamples { 0 };
+        HaltonBatch                _haltonBatch; // points of the current pass, used by SamplerType::Halton
+
+        bool              _showSampleMap { false };
+        Common::ImageRGB  _sampleMap; // samples per pixel as a heat map, rebuilt after every pass
+        std::mutex        _sampleMapMutex;
+        std::atomic<bool> _sampleMapDirty { false };
+
+        std::atomic<bool>       _showCostMap { false }; // takes precedence over the sample map
+        std::atomic<CostMetric> _costMetric { CostMetric::Time };
+        CostMap                 _costMap;   // written by the render task only
+        Common::ImageRGB        _costImage; // _costMap in false colour, rebuilt after every pass
+        std::atomic<float>      _costScale { 0 };
+        std::mutex              _costImageMutex;
+        std::atomic<bool>       _costImageDirty { false };
+
+        TileRenderer   _renderer;
+        int            _numThreads { 0 }; // copied into _renderer.Options whenever rendering starts
+        int            _tileSize { 32 };
+        TraversalOrder _traversalOrder { TraversalOrder::Hilbert };
+
+        Engine::Async<std::vector<BVHLayoutBenchmark>> _benchmark; // layout benchmark, queued on the RenderScheduler
+
+        Engine::Async<bool> _task;                // render loop, queued on the RenderScheduler; kept after Cancel() until it returned
+        bool                _suspended { false }; // _stopFlag was raised because the case left the screen
+
+        bool            _enablePreview { true };
+        bool            _previewReady { false }; // _previewTexture holds a pass of the current scene and settings
+        PreviewRenderer _preview;                // last, so that it stops before anything it traces is destroyed
+
+        void PublishSampleMap();
+        void PublishCostMap(); // only while no tile is being traced
+
+        bool IsBenchmarking() const { return _benchmark.IsValid() && ! _benchmark.IsCompleted(); }
+
+        // what the tracing threads read of the UI state, copied whenever tracing starts.
+        struct Settings {
+            std::size_t        SceneIdx;
+            IntersectorOptions Intersector;
+            int                MaximumDepth;
+            SamplerType        Sampler;
+            int                SamplesPerPixel;
+            int                SamplesPerPass;
+            bool               Adaptive;
+            float              ErrorThreshold;
+            int                MinSamples;
+        };
+
+        Settings GetSettings() const;
+
+        // samples estimate takes in the next pass, 0 once it reached the target or converged.
+        static int GetPassSamples(PixelEstimate const & estimate, Settings const & settings);
+
+        // builds the intersector unless it was built from the same scene and options, from whichever thread is about to trace.
+        void PrepareScene(Settings const & settings);
 
         auto GetBufferSize() const { return std::pair<std::uint32_t, std::uint32_t>(_buffer.GetSizeX(), _buffer.GetSizeY()); }
 
         char const *          GetSceneName(std::size_t const i) const { return Content::SceneNames[std::size_t(_scenes[i])].c_str(); }
         Engine::Scene const & GetScene(std::size_t const i) const { return Content::Scenes[std::size_t(_scenes[i])]; }
+        std::filesystem::path GetSceneCacheDirectory(std::size_t const i) const { return std::filesystem::path(Assets::ExampleScenes[std::size_t(_scenes[i])]).parent_path() / ".bvhcache"; }
     };
 } // namespace VCX::Labs::Rendering
\ No newline at end of file
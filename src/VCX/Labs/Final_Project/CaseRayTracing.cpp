@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "Engine/Trace.h"
 #include "Labs/Final_Project/CaseRayTracing.h"
 
 namespace VCX::Labs::Rendering {
@@ -7,14 +12,31 @@ namespace VCX::Labs::Rendering {
         _program(
             Engine::GL::UniqueProgram({ Engine::GL::SharedShader("assets/shaders/flat.vert"), Engine::GL::SharedShader("assets/shaders/flat.frag") })),
         _sceneObject(4),
-        _texture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Nearest }) {
+        _texture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Nearest }),
+        _previewTexture({ .MinFilter = Engine::GL::FilterMode::Linear, .MagFilter = Engine::GL::FilterMode::Linear }) {
         _cameraManager.AutoRotate = false;
         _program.GetUniforms().SetByName("u_Color", glm::vec3(1, 1, 1));
+        Common::RenderScheduler::Get().Register(
+            this,
+            [this]() {
+                // stopped as if by the user, but resumed as soon as the case is back on screen.
+                _preview.Cancel();
+                if (! _task.IsValid() || _stopFlag) return;
+                _stopFlag = true;
+                _task.Cancel();
+                _suspended = true;
+            },
+            [this]() {
+                if (_suspended) _stopFlag = false;
+                _suspended = false;
+            });
     }
 
     CaseRayTracing::~CaseRayTracing() {
-        _stopFlag = true;
-        if (_task.joinable()) _task.join();
+        Common::RenderScheduler::Get().Unregister(this);
+        _task.Cancel();
+        _task.Wait();
+        _benchmark.Wait();
     }
 
     void CaseRayTracing::OnSetupPropsUI() {
@@ -25,7 +47,6 @@ namespace VCX::Labs::Rendering {
                     if (! selected) {
                         _sceneIdx   = i;
                         _sceneDirty = true;
-                        _treeDirty  = true;
                         _resetDirty = true;
                     }
                 }
@@ -34,13 +55,13 @@ namespace VCX::Labs::Rendering {
         }
         if (ImGui::Button("Reset Scene")) _resetDirty = true;
         ImGui::SameLine();
-        if (_task.joinable()) {
+        if (! _stopFlag) {
             if (ImGui::Button("Stop Rendering")) {
                 _stopFlag = true;
-                if (_task.joinable()) _task.join();
+                _task.Cancel();
             }
         } else if (ImGui::Button("Start Rendering")) _stopFlag = false;
-        ImGui::ProgressBar(float(_pixelIndex) / (_buffer.GetSizeX() * _buffer.GetSizeY()));
+        ImGui::ProgressBar(_renderer.GetProgress());
         Common::ImGuiHelper::SaveImage(_texture, GetBufferSize(), true);
         ImGui::Spacing();
 
@@ -48,24 +69,150 @@ namespace VCX::Labs::Rendering {
             _resetDirty |= ImGui::SliderInt("Sample Rate", &_superSampleRate, 1, 5);
             _resetDirty |= ImGui::SliderInt("Max Depth", &_maximumDepth, 1, 15);
             _resetDirty |= ImGui::Checkbox("Shadow Ray", &_enableShadow);
+            bool showCostMap = _showCostMap;
+            if (ImGui::Checkbox("Show Cost Map", &showCostMap)) {
+                _showCostMap    = showCostMap;
+                _costImageDirty = true;
+                _renderer.Invalidate();
+                // a running render task publishes when it returns.
+                if (showCostMap && ! _task.IsValid()) PublishCostMap();
+            }
+            if (showCostMap) {
+                static char const * const metricNames[] = { "time", "traversal steps" };
+                int                       metric        = int(_costMetric.load());
+                if (ImGui::Combo("Cost Metric", &metric, metricNames, IM_ARRAYSIZE(metricNames))) {
+                    _costMetric = CostMetric(metric);
+                    if (! _task.IsValid()) PublishCostMap();
+                }
+                if (_costScale > 0)
+                    ImGui::Text(_costMetric == CostMetric::Time ? "White: %.2f us per sample" : "White: %.0f steps per sample", _costScale.load());
+            }
         }
         ImGui::Spacing();
 
         if (ImGui::CollapsingHeader("Control")) {
             ImGui::Checkbox("Zoom Tooltip", &_enableZoom);
+            if (ImGui::Checkbox("Ray-Traced Preview", &_enablePreview) && ! _enablePreview) {
+                _preview.Cancel();
+                _previewReady = false;
+            }
+            ImGui::SliderInt("Threads", &_numThreads, 0, int(std::max(1u, std::thread::hardware_concurrency())), _numThreads ? "%d" : "auto");
+            _resetDirty |= ImGui::SliderInt("Tile Size", &_tileSize, 8, 128);
+            static char const * const orderNames[] = { "scanline", "Morton", "Hilbert" };
+            int                       order        = int(_traversalOrder);
+            if (ImGui::Combo("Traversal Order", &order, orderNames, IM_ARRAYSIZE(orderNames))) {
+                _traversalOrder = TraversalOrder(order);
+                _resetDirty     = true;
+            }
+            static char const * const structureNames[] = { "BVH", "kd-tree" };
+            int                       structure        = int(_intersectorOptions.Structure);
+            if (ImGui::Combo("Accelerator", &structure, structureNames, IM_ARRAYSIZE(structureNames))) {
+                _intersectorOptions.Structure = AccelerationStructure(structure);
+                _resetDirty                   = true;
+            }
+            if (_intersectorOptions.Structure == AccelerationStructure::BVH) {
+                static char const * const layoutNames[] = { "binary", "8-wide", "8-wide quantized" };
+                int                       layout        = int(_intersectorOptions.BVHOptions.Layout);
+                if (ImGui::Combo("BVH Layout", &layout, layoutNames, IM_ARRAYSIZE(layoutNames))) {
+                    _intersectorOptions.BVHOptions.Layout = BVHLayout(layout);
+                    _resetDirty                           = true;
+                }
+                static char const * const builderNames[] = { "binned SAH", "Morton" };
+                int                       builder        = int(_intersectorOptions.BVHOptions.Builder);
+                if (ImGui::Combo("BVH Builder", &builder, builderNames, IM_ARRAYSIZE(builderNames))) {
+                    _intersectorOptions.BVHOptions.Builder = BVHBuilder(builder);
+                    _resetDirty                            = true;
+                }
+                bool avx2 = WideBVH::IsAVX2Enabled();
+                if (_intersectorOptions.BVHOptions.Layout != BVHLayout::Binary && WideBVH::IsAVX2Supported() && ImGui::Checkbox("AVX2", &avx2)) {
+                    WideBVH::SetAVX2Enabled(avx2);
+                    _resetDirty = true;
+                }
+                if (IsBenchmarking()) ImGui::Text("Benchmarking...");
+                else if (ImGui::Button("Benchmark Layouts")) {
+                    // the render loop and the preview stay stopped so that they do not skew the timings.
+                    _stopFlag = true;
+                    _task.Cancel();
+                    _preview.Cancel();
+                    _benchmark = Common::RenderScheduler::Get().Submit<std::vector<BVHLayoutBenchmark>>(
+                        this, [this, &scene = GetScene(_sceneIdx), camera = _sceneObject.Camera, options = _intersectorOptions.BVHOptions]() {
+                            // waits here rather than on the UI thread for a build the preview already started.
+                            _preview.Stop();
+                            return BenchmarkBVHLayouts(scene, camera, options);
+                        });
+                }
+                if (_benchmark.HasValue())
+                    for (auto const & result : _benchmark.Value())
+                        ImGui::Text(
+                            "%s: %.1f + %.1f MB, %.2f / %.2f Mrays/s",
+                            layoutNames[int(result.Layout)],
+                            result.NodeBytes / 1048576.,
+                            result.PrimitiveBytes / 1048576.,
+                            result.PrimaryMRays,
+                            result.SecondaryMRays);
+            }
+            if (_intersectorOptions.Structure == AccelerationStructure::KdTree) {
+                auto & options = _intersectorOptions.KdTreeOptions;
+                _resetDirty |= ImGui::SliderFloat("Traversal Cost", &options.TraversalCost, .1f, 10.f);
+                _resetDirty |= ImGui::SliderFloat("Intersection Cost", &options.IntersectionCost, 1.f, 200.f);
+                _resetDirty |= ImGui::SliderInt("Max Tree Depth", &options.MaxDepth, 0, 40, options.MaxDepth ? "%d" : "auto");
+            }
+            AccelStatistics stats;
+            {
+                std::lock_guard lock(_builtStatisticsMutex);
+                stats = _builtStatistics;
+            }
+            ImGui::Text("Tree: %zu nodes, %zu refs, depth %zu", stats.NumNodes, stats.NumReferences, stats.MaxDepth);
+            ImGui::Text("Build: %.1f ms, SAH cost %.2f", stats.BuildTime, stats.SAHCost);
+            ImGui::Text("Memory: %.1f MB nodes, %.1f MB triangles", stats.NodeBytes / 1048576., stats.PrimitiveBytes / 1048576.);
+            if (_renderTime > 0)
+                ImGui::Text("Trace: %.2f s, %.3f Mrays/s", _renderTime.load(), _intersector.GetRayCount() * 1e-6 / _renderTime);
+            auto const &    rayStats = _intersector.GetRayStatistics();
+            RayCounts const counts   = rayStats.Gather();
+            if (counts.GetRays() > 0) {
+                double const rays = double(counts.GetRays());
+                ImGui::Text("Rays: %.2fM camera, %.2fM bounce, %.2fM shadow", counts.CameraRays * 1e-6, counts.BounceRays * 1e-6, counts.ShadowRays * 1e-6);
+                ImGui::Text("Per Ray: %.1f nodes, %.1f triangles", counts.NodesVisited / rays, counts.TrianglesTested / rays);
+                ImGui::Text("Paths: %.2f vertices on average", counts.GetAveragePathLength());
+            }
+            if (rayStats.GetNumPasses() > 0)
+                ImGui::Text("Passes: %d, last %.1f ms, average %.1f ms", rayStats.GetNumPasses(), rayStats.GetLastPassTime() * 1e3, rayStats.GetPassTime() * 1e3 / rayStats.GetNumPasses());
+            static char statisticsPath[128] = "ray-statistics.json";
+            if (ImGui::Button("Save Statistics")) WriteRayStatistics(statisticsPath, rayStats);
+            ImGui::SameLine();
+            ImGui::InputText("##statistics", statisticsPath, IM_ARRAYSIZE(statisticsPath));
+            // the tracer is process-wide, so both cases show the same recording.
+            static char tracePath[128] = "trace.json";
+            bool        tracing        = Engine::Tracer::Get().IsEnabled();
+            if (ImGui::Checkbox("Record Trace", &tracing)) {
+                if (tracing) Engine::Tracer::Get().Start();
+                else Engine::Tracer::Get().Stop(tracePath);
+            }
+            ImGui::SameLine();
+            ImGui::InputText("##trace", tracePath, IM_ARRAYSIZE(tracePath));
         }
         ImGui::Spacing();
     }
 
     Common::CaseRenderResult CaseRayTracing::OnRender(std::pair<std::uint32_t, std::uint32_t> const desiredSize) {
+        // a cancelled task is only let go once it returned, until then it still touches the renderer and the buffer.
+        if (_task.IsCompleted()) {
+            if (! _task.IsCancelled()) _stopFlag = true; // finished, or failed
+            _task.Reset();
+        }
         if (_resetDirty) {
             _stopFlag = true;
-            if (_task.joinable()) _task.join();
-            _pixelIndex = 0;
+            _task.Cancel();
+            _preview.Cancel();
+            _previewReady = false;
+        }
+        // rather than blocking the UI thread, the reset waits for the first frame without a task.
+        if (_resetDirty && ! _task.IsValid()) {
+            _renderer.Reset();
             _resizable  = true;
             _resetDirty = false;
         }
-        if (_sceneDirty) {
+        if (_sceneDirty && ! _resetDirty) {
             _sceneObject.ReplaceScene(GetScene(_sceneIdx));
             _cameraManager.Save(_sceneObject.Camera);
             _sceneDirty = false;
@@ -84,62 +231,125 @@ namespace VCX::Labs::Rendering {
                 model.Mesh.Draw({ _program.Use() });
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
             glDisable(GL_DEPTH_TEST);
+
+            if (_enablePreview && _stopFlag && ! _task.IsValid() && ! IsBenchmarking()) {
+                Settings const settings = GetSettings();
+                _preview.Request(
+                    _sceneObject.Camera,
+                    desiredSize,
+                    { .NumThreads = _numThreads, .TileSize = 16, .Order = _traversalOrder },
+                    [this, settings]() { PrepareScene(settings); },
+                    [this, settings](Ray const & ray, std::size_t, std::size_t) {
+                        return glm::pow(RayTrace(_intersector, ray, settings.MaximumDepth, settings.EnableShadow), glm::vec3(1.0 / 2.2));
+                    });
+                _preview.SyncImage([&](Common::ImageRGB const & image) {
+                    _previewTexture.Update(image);
+                    _previewReady = true;
+                });
+            }
         }
-        if (! _stopFlag && ! _task.joinable()) {
-            if (_pixelIndex == 0) {
+        if (! _stopFlag && ! _task.IsValid()) {
+            if (_renderer.GetFinishedPixels() == 0) {
+                _renderer.Reset();
                 _resizable = false;
                 _buffer    = _frame.GetColorAttachment().Download<Engine::Formats::RGB8>();
             }
-            _task = std::thread([&]() {
+            // the thread count takes effect whenever rendering (re)starts, the tile size on reset.
+            _renderer.Options = { .NumThreads = _numThreads, .TileSize = _tileSize, .Order = _traversalOrder };
+
+            _task = Common::RenderScheduler::Get().Submit<bool>(this, [&, settings = GetSettings()](Engine::CancellationToken const & token) {
                 auto const width  = _buffer.GetSizeX();
                 auto const height = _buffer.GetSizeY();
-                if (_pixelIndex == 0 && _treeDirty) {
-                    Engine::Scene const & scene = GetScene(_sceneIdx);
-                    _intersector.InitScene(&scene);
-                    _treeDirty = false;
+                // the preview shares the intersector, it has to be idle before the tree may be rebuilt. waiting here
+                // rather than on the UI thread lets a build the preview already started finish in the background.
+                _preview.Stop();
+                PrepareScene(settings);
+                if (_renderer.GetFinishedPixels() == 0) {
+                    _intersector.ResetRayStatistics();
+                    _costMap.Reset(width, height);
+                    _renderTime = 0;
                 }
+                auto const start          = std::chrono::steady_clock::now();
+                auto const AccumulateTime = [&]() {
+                    _renderTime = _renderTime + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                };
                 // Render into tex.
-                while (_pixelIndex < std::size_t(width) * height) {
-                    int       i = _pixelIndex % width;
-                    int       j = _pixelIndex / width;
-                    glm::vec3 sum(0.0f);
-                    for (int dy = 0; dy < _superSampleRate; ++dy)
-                        for (int dx = 0; dx < _superSampleRate; ++dx) {
-                            float        step = 1.0f / _superSampleRate;
-                            float        di = step * (0.5f + dx), dj = step * (0.5f + dy);
-                            auto const & camera    = _sceneObject.Camera;
-                            glm::vec3    lookDir   = glm::normalize(camera.Target - camera.Eye);
-                            glm::vec3    rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
-                            glm::vec3    upDir     = glm::normalize(glm::cross(rightDir, lookDir));
-                            float const  aspect    = width * 1.f / height;
-                            float const  fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
-                            lookDir += fovFactor * (2.0f * (j + dj) / height - 1.0f) * upDir;
-                            lookDir += fovFactor * aspect * (2.0f * (i + di) / width - 1.0f) * rightDir;
-                            Ray       initialRay(camera.Eye, glm::normalize(lookDir));
-                            glm::vec3 res = RayTrace(_intersector, initialRay, _maximumDepth, _enableShadow);
-                            sum += glm::pow(res, glm::vec3(1.0 / 2.2));
-                        }
-                    _buffer.At(i, j) = sum / glm::vec3(_superSampleRate * _superSampleRate);
-                    ++_pixelIndex;
-                    if (_stopFlag) return;
-                }
+                bool const finished = _renderer.Render(_buffer, [&](std::size_t const i, std::size_t const j) {
+                    int const rate = settings.SuperSampleRate;
+                    return _costMap.Measure(i, j, rate * rate, [&]() {
+                        glm::vec3 sum(0.0f);
+                        for (int dy = 0; dy < rate; ++dy)
+                            for (int dx = 0; dx < rate; ++dx) {
+                                float        step = 1.0f / rate;
+                                float        di = step * (0.5f + dx), dj = step * (0.5f + dy);
+                                auto const & camera    = _sceneObject.Camera;
+                                glm::vec3    lookDir   = glm::normalize(camera.Target - camera.Eye);
+                                glm::vec3    rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+                                glm::vec3    upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+                                float const  aspect    = width * 1.f / height;
+                                float const  fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+                                lookDir += fovFactor * (2.0f * (j + dj) / height - 1.0f) * upDir;
+                                lookDir += fovFactor * aspect * (2.0f * (i + di) / width - 1.0f) * rightDir;
+                                Ray       initialRay(camera.Eye, glm::normalize(lookDir));
+                                glm::vec3 res = RayTrace(_intersector, initialRay, settings.MaximumDepth, settings.EnableShadow);
+                                sum += glm::pow(res, glm::vec3(1.0 / 2.2));
+                            }
+                        return sum / glm::vec3(rate * rate);
+                    });
+                }, token);
+                AccumulateTime();
+                if (_showCostMap) PublishCostMap();
+                if (! finished) return false;
+                _intersector.GetRayStatistics().AddPass(_renderTime);
+                spdlog::info(
+                    "VCX::Labs::Rendering::CaseRayTracing::OnRender(..): {} rays in {:.2f} s, {:.3f} Mrays/s.",
+                    _intersector.GetRayCount(),
+                    _renderTime.load(),
+                    _intersector.GetRayCount() * 1e-6 / _renderTime);
+                return true;
             });
         }
         if (! _resizable) {
-            if (! _stopFlag) _texture.Update(_buffer);
-            if (_task.joinable() && _pixelIndex == _buffer.GetSizeX() * _buffer.GetSizeY()) {
-                _stopFlag = true;
-                _task.join();
+            if (! _showCostMap) {
+                _renderer.SyncImage([&]() { _texture.Update(_buffer); });
+            } else if (_costImageDirty.exchange(false)) {
+                std::lock_guard lock(_costImageMutex);
+                if (_costImage.GetSizeX() > 0) _texture.Update(_costImage);
             }
         }
         return Common::CaseRenderResult {
             .Fixed     = false,
             .Flipped   = true,
-            .Image     = _resizable ? _frame.GetColorAttachment() : _texture,
+            .Image     = _resizable ? (_enablePreview && _previewReady ? _previewTexture : _frame.GetColorAttachment()) : _texture,
             .ImageSize = _resizable ? desiredSize : GetBufferSize(),
         };
     }
 
+    void CaseRayTracing::PublishCostMap() {
+        float            scale;
+        Common::ImageRGB image = _costMap.GetImage(_costMetric, scale);
+        std::lock_guard  lock(_costImageMutex);
+        _costImage      = std::move(image);
+        _costScale      = scale;
+        _costImageDirty = true;
+    }
+
+    CaseRayTracing::Settings CaseRayTracing::GetSettings() const {
+        IntersectorOptions intersector = _intersectorOptions;
+        intersector.CacheDirectory     = GetSceneCacheDirectory(_sceneIdx);
+        return { _sceneIdx, std::move(intersector), _maximumDepth, _enableShadow, _superSampleRate };
+    }
+
+    void CaseRayTracing::PrepareScene(Settings const & settings) {
+        if (_builtOptions && _builtSceneIdx == settings.SceneIdx && *_builtOptions == settings.Intersector) return;
+        _intersector.SetOptions(settings.Intersector);
+        _intersector.InitScene(&GetScene(settings.SceneIdx));
+        _builtSceneIdx = settings.SceneIdx;
+        _builtOptions  = settings.Intersector;
+        std::lock_guard lock(_builtStatisticsMutex);
+        _builtStatistics = _intersector.GetStatistics();
+    }
+
     void CaseRayTracing::OnProcessInput(ImVec2 const & pos) {
         auto         window  = ImGui::GetCurrentWindow();
         bool         hovered = false;
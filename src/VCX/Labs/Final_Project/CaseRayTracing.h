@@ -1,12 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <optional>
+
 #include "Engine/GL/Frame.hpp"
 #include "Engine/GL/Program.h"
 #include "Labs/Common/ICase.h"
 #include "Labs/Common/ImageRGB.h"
 #include "Labs/Common/OrbitCameraManager.h"
+#include "Labs/Common/RenderScheduler.h"
+#include "Labs/Final_Project/Benchmark.h"
 #include "Labs/Final_Project/Content.h"
+#include "Labs/Final_Project/CostMap.h"
+#include "Labs/Final_Project/PreviewRenderer.h"
 #include "Labs/Final_Project/SceneObject.h"
+#include "Labs/Final_Project/TileRenderer.h"
 #include "Labs/Final_Project/tasks.h"
 
 namespace VCX::Labs::Rendering {
@@ -30,26 +39,73 @@ namespace VCX::Labs::Rendering {
         Common::OrbitCameraManager              _cameraManager;
 
         Engine::GL::UniqueTexture2D _texture;
+        Engine::GL::UniqueTexture2D _previewTexture;
         RayIntersector              _intersector;
+        IntersectorOptions          _intersectorOptions; // edited by the UI, the tracing threads get theirs through Settings
+
+        // what _intersector was last built from, only touched by PrepareScene(..).
+        std::size_t                       _builtSceneIdx { 0 };
+        std::optional<IntersectorOptions> _builtOptions;
+        AccelStatistics                   _builtStatistics; // of _intersector, copied for the UI once a build finishes
+        std::mutex                        _builtStatisticsMutex;
 
         std::size_t      _sceneIdx { 0 };
         bool             _enableZoom { true };
         bool             _enableShadow { true };
         int              _maximumDepth { 3 };
         int              _superSampleRate { 1 };
-        std::size_t      _pixelIndex { 0 };
-        bool             _stopFlag { true };
         bool             _sceneDirty { true };
-        bool             _treeDirty { true };
         bool             _resetDirty { true };
         Common::ImageRGB _buffer;
         bool             _resizable { true };
 
-        std::thread _task;
+        std::atomic<double> _renderTime { 0 };  // seconds spent tracing the current image
+        bool                _stopFlag { true }; // UI thread only, the render task polls the token of _task
+
+        std::atomic<bool>       _showCostMap { false };
+        std::atomic<CostMetric> _costMetric { CostMetric::Time };
+        CostMap                 _costMap;   // written by the render task only
+        Common::ImageRGB        _costImage; // _costMap in false colour, rebuilt whenever the render task returns
+        std::atomic<float>      _costScale { 0 };
+        std::mutex              _costImageMutex;
+        std::atomic<bool>       _costImageDirty { false };
+
+        TileRenderer   _renderer;
+        int            _numThreads { 0 }; // copied into _renderer.Options whenever rendering starts
+        int            _tileSize { 32 };
+        TraversalOrder _traversalOrder { TraversalOrder::Hilbert };
+
+        Engine::Async<std::vector<BVHLayoutBenchmark>> _benchmark; // layout benchmark, queued on the RenderScheduler
+
+        Engine::Async<bool> _task;                // render loop, queued on the RenderScheduler; kept after Cancel() until it returned
+        bool                _suspended { false }; // _stopFlag was raised because the case left the screen
+
+        bool            _enablePreview { true };
+        bool            _previewReady { false }; // _previewTexture holds a pass of the current scene and settings
+        PreviewRenderer _preview;                // last, so that it stops before anything it traces is destroyed
+
+        void PublishCostMap(); // only while no tile is being traced
+
+        bool IsBenchmarking() const { return _benchmark.IsValid() && ! _benchmark.IsCompleted(); }
+
+        // what the tracing threads read of the UI state, copied whenever tracing starts.
+        struct Settings {
+            std::size_t        SceneIdx;
+            IntersectorOptions Intersector;
+            int                MaximumDepth;
+            bool               EnableShadow;
+            int                SuperSampleRate;
+        };
+
+        Settings GetSettings() const;
+
+        // builds the intersector unless it was built from the same scene and options, from whichever thread is about to trace.
+        void PrepareScene(Settings const & settings);
 
         auto GetBufferSize() const { return std::pair(std::uint32_t(_buffer.GetSizeX()), std::uint32_t(_buffer.GetSizeY())); }
 
         char const *          GetSceneName(std::size_t const i) const { return Content::SceneNames[std::size_t(_scenes[i])].c_str(); }
         Engine::Scene const & GetScene(std::size_t const i) const { return Content::Scenes[std::size_t(_scenes[i])]; }
+        std::filesystem::path GetSceneCacheDirectory(std::size_t const i) const { return std::filesystem::path(Assets::ExampleScenes[std::size_t(_scenes[i])]).parent_path() / ".bvhcache"; }
     };
 } // namespace VCX::Labs::Rendering
@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "Labs/Final_Project/CostMap.h"
+
+namespace VCX::Labs::Rendering {
+
+    void CostMap::Reset(std::size_t const width, std::size_t const height) {
+        _width  = width;
+        _height = height;
+        _pixels.assign(width * height, Pixel());
+    }
+
+    Common::ImageRGB CostMap::GetImage(CostMetric const metric, float & scale) const {
+        std::vector<float> costs(_pixels.size(), -1.f);
+        std::vector<float> measured;
+        measured.reserve(_pixels.size());
+        for (std::size_t k = 0; k < _pixels.size(); ++k) {
+            Pixel const & pixel = _pixels[k];
+            if (pixel.Samples == 0) continue;
+            costs[k] = (metric == CostMetric::Time ? pixel.Time : pixel.Steps) / pixel.Samples;
+            measured.push_back(costs[k]);
+        }
+        scale = 0;
+        if (! measured.empty()) {
+            auto const percentile = measured.begin() + std::ptrdiff_t((measured.size() - 1) * 99 / 100);
+            std::nth_element(measured.begin(), percentile, measured.end());
+            scale = *percentile;
+        }
+        float const      invScale = scale > 0 ? 1.f / scale : 0.f;
+        Common::ImageRGB image(_width, _height);
+        for (std::size_t j = 0; j < _height; ++j)
+            for (std::size_t i = 0; i < _width; ++i) {
+                float const cost = costs[j * _width + i];
+                image.At(i, j)   = cost < 0 ? glm::vec3(0) : GetHeatColor(cost * invScale);
+            }
+        return image;
+    }
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Labs/Common/ImageRGB.h"
+#include "Labs/Final_Project/Accel.h"
+
+namespace VCX::Labs::Rendering {
+
+    // black, red, yellow, white as t goes from 0 to 1.
+    inline glm::vec3 GetHeatColor(float const t) {
+        return glm::clamp(glm::vec3(3.f * t, 3.f * t - 1.f, 3.f * t - 2.f), 0.f, 1.f);
+    }
+
+    enum class CostMetric {
+        Time,      // wall-clock time of the shading thread
+        Traversal, // BVH or kd-tree nodes visited plus triangles tested
+    };
+
+    // what shading each pixel cost, per camera sample, so that passes of different sample counts and pixels
+    // that stopped early under adaptive sampling stay comparable. both metrics are always recorded.
+    class CostMap {
+    public:
+        // clears every pixel, only call while nothing is measured.
+        void Reset(std::size_t const width, std::size_t const height);
+
+        // returns shade(), which traces samples camera samples of pixel (x, y), and adds what it cost. the traversal
+        // steps are read from GetTraversalCounters() of the calling thread, so a pixel has to be shaded on a single thread.
+        template<typename Func>
+        glm::vec3 Measure(std::size_t const x, std::size_t const y, int const samples, Func && shade) {
+            TraversalCounters const before = GetTraversalCounters();
+            auto const              start  = std::chrono::steady_clock::now();
+            glm::vec3 const         value  = shade();
+            auto const              end    = std::chrono::steady_clock::now();
+            TraversalCounters const after  = GetTraversalCounters();
+            Pixel &                 pixel  = _pixels[y * _width + x];
+            pixel.Time += float(std::chrono::duration<double, std::micro>(end - start).count());
+            pixel.Steps += float(after.NodesVisited - before.NodesVisited + after.TrianglesTested - before.TrianglesTested);
+            pixel.Samples += std::uint32_t(samples);
+            return value;
+        }
+
+        // false colour image of the cost per sample. white stands for the 99th percentile rather than the
+        // maximum, so that a handful of outliers cannot darken the rest; scale returns that cost, in
+        // microseconds or steps. pixels never measured stay black. only call while nothing is measured.
+        Common::ImageRGB GetImage(CostMetric const metric, float & scale) const;
+
+    private:
+        struct Pixel {
+            float         Time { 0 };  // in microseconds
+            float         Steps { 0 };
+            std::uint32_t Samples { 0 };
+        };
+
+        std::size_t        _width { 0 };
+        std::size_t        _height { 0 };
+        std::vector<Pixel> _pixels; // row by row
+    };
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+#include <spdlog/spdlog.h>
+
+#include "Engine/Trace.h"
+#include "Labs/Final_Project/KdTree.h"
+#include "Labs/Final_Project/tasks.h"
+
+namespace VCX::Labs::Rendering {
+
+    static constexpr int c_MaxKdTreeDepth = 64; // also bounds the traversal stack
+    static constexpr int c_MaxKdTreeBins  = 256;
+
+    namespace {
+        struct KdBuildContext {
+            KdTreeBuildOptions const &   Options;
+            int                          MaxDepth;
+            float                        InvRootArea;
+            std::vector<AABB>            Bounds;
+            std::vector<KdTreeNode> &    Nodes;
+            std::vector<std::uint32_t> & Primitives;
+            AccelStatistics &            Statistics;
+        };
+    } // namespace
+
+    static void BuildRecursive(KdBuildContext & ctx, AABB const & nodeBounds, std::vector<std::uint32_t> & prims, int const depth, int badRefines) {
+        auto const        nodeIdx = std::uint32_t(ctx.Nodes.size());
+        std::size_t const count   = prims.size();
+        float const       area    = nodeBounds.GetSurfaceArea();
+        ctx.Nodes.emplace_back();
+        ctx.Statistics.MaxDepth = std::max(ctx.Statistics.MaxDepth, std::size_t(depth));
+
+        auto const MakeLeaf = [&]() {
+            ctx.Nodes[nodeIdx].PrimitiveOffset = std::uint32_t(ctx.Primitives.size());
+            ctx.Nodes[nodeIdx].Flags           = 3u | (std::uint32_t(count) << 2);
+            ctx.Primitives.insert(ctx.Primitives.end(), prims.begin(), prims.end());
+            ctx.Statistics.NumLeaves += 1;
+            ctx.Statistics.SAHCost += area * ctx.InvRootArea * ctx.Options.IntersectionCost * count;
+        };
+        if (count <= std::size_t(std::max(ctx.Options.MaxLeafSize, 0)) || depth >= ctx.MaxDepth) return MakeLeaf();
+
+        // binned SAH: candidate planes lie on the NumBins - 1 inner bin boundaries of the node extent.
+        int const       numBins   = std::clamp(ctx.Options.NumBins, 2, c_MaxKdTreeBins);
+        float const     invArea   = 1.f / std::max(area, std::numeric_limits<float>::min());
+        glm::vec3 const extent    = nodeBounds.Max - nodeBounds.Min;
+        float           bestCost  = std::numeric_limits<float>::max();
+        int             bestAxis  = -1;
+        float           bestSplit = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0) continue;
+            std::array<std::size_t, c_MaxKdTreeBins> minBins { }, maxBins { };
+            float const                              scale = numBins / extent[axis];
+            for (auto const p : prims) {
+                float const lo = std::max(ctx.Bounds[p].Min[axis], nodeBounds.Min[axis]);
+                float const hi = std::min(ctx.Bounds[p].Max[axis], nodeBounds.Max[axis]);
+                minBins[std::clamp(int((lo - nodeBounds.Min[axis]) * scale), 0, numBins - 1)]++;
+                maxBins[std::clamp(int((hi - nodeBounds.Min[axis]) * scale), 0, numBins - 1)]++;
+            }
+            int const   axis1 = (axis + 1) % 3, axis2 = (axis + 2) % 3;
+            float const cap   = extent[axis1] * extent[axis2];
+            float const rim   = extent[axis1] + extent[axis2];
+            std::size_t nBelow = 0, nAbove = count;
+            for (int k = 1; k < numBins; ++k) {
+                nBelow += minBins[k - 1];
+                nAbove -= maxBins[k - 1];
+                float const split      = nodeBounds.Min[axis] + k * extent[axis] / numBins;
+                float const belowArea  = 2.f * (cap + (split - nodeBounds.Min[axis]) * rim);
+                float const aboveArea  = 2.f * (cap + (nodeBounds.Max[axis] - split) * rim);
+                float const emptyBonus = (nBelow == 0 || nAbove == 0) ? ctx.Options.EmptyBonus : 0.f;
+                float const cost       = ctx.Options.TraversalCost
+                    + ctx.Options.IntersectionCost * (1.f - emptyBonus) * (belowArea * nBelow + aboveArea * nAbove) * invArea;
+                if (cost < bestCost) {
+                    bestCost  = cost;
+                    bestAxis  = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // same termination rules as pbrt: tolerate a few splits that do not pay off, hoping later ones will.
+        float const leafCost = ctx.Options.IntersectionCost * count;
+        if (bestCost > leafCost) ++badRefines;
+        if (bestAxis < 0 || (bestCost > 4 * leafCost && count < 16) || badRefines == 3) return MakeLeaf();
+
+        std::vector<std::uint32_t> below, above;
+        for (auto const p : prims) {
+            if (ctx.Bounds[p].Min[bestAxis] <= bestSplit) below.push_back(p);
+            if (ctx.Bounds[p].Max[bestAxis] >= bestSplit) above.push_back(p);
+        }
+        prims.clear();
+        prims.shrink_to_fit();
+
+        AABB belowBounds = nodeBounds, aboveBounds = nodeBounds;
+        belowBounds.Max[bestAxis] = bestSplit;
+        aboveBounds.Min[bestAxis] = bestSplit;
+        ctx.Statistics.SAHCost += area * ctx.InvRootArea * ctx.Options.TraversalCost;
+
+        BuildRecursive(ctx, belowBounds, below, depth + 1, badRefines);
+        auto const aboveIdx = std::uint32_t(ctx.Nodes.size());
+        BuildRecursive(ctx, aboveBounds, above, depth + 1, badRefines);
+        ctx.Nodes[nodeIdx].Split = bestSplit;
+        ctx.Nodes[nodeIdx].Flags = std::uint32_t(bestAxis) | (aboveIdx << 2);
+    }
+
+    void KdTree::Build(Engine::Scene const & scene, KdTreeBuildOptions const & options) {
+        Engine::TraceScope const trace("BuildKdTree", "build");
+        auto const               start = std::chrono::steady_clock::now();
+        Clear();
+
+        _triangles               = GatherTriangles(scene);
+        _statistics.NumTriangles = _triangles.size();
+        if (_triangles.empty()) return;
+
+        std::vector<AABB>          bounds(_triangles.size());
+        std::vector<std::uint32_t> prims(_triangles.size());
+        for (std::size_t i = 0; i < _triangles.size(); ++i) {
+            bounds[i].Extend(_triangles[i].P1);
+            bounds[i].Extend(_triangles[i].P2);
+            bounds[i].Extend(_triangles[i].P3);
+            _bounds.Extend(bounds[i]);
+            prims[i] = std::uint32_t(i);
+        }
+        // enlarge the root cell a little so that rays grazing the scene bounds are not lost to rounding.
+        glm::vec3 const margin = glm::max(_bounds.Max - _bounds.Min, glm::vec3(1.f)) * EPS3;
+        _bounds.Min -= margin;
+        _bounds.Max += margin;
+
+        int const maxDepth = options.MaxDepth > 0
+            ? std::min(options.MaxDepth, c_MaxKdTreeDepth - 1)
+            : std::min(int(std::round(8 + 1.3f * std::log2(float(_triangles.size())))), c_MaxKdTreeDepth - 1);
+
+        KdBuildContext ctx {
+            .Options     = options,
+            .MaxDepth    = maxDepth,
+            .InvRootArea = 1.f / std::max(_bounds.GetSurfaceArea(), std::numeric_limits<float>::min()),
+            .Bounds      = std::move(bounds),
+            .Nodes       = _nodes,
+            .Primitives  = _primitives,
+            .Statistics  = _statistics,
+        };
+        BuildRecursive(ctx, _bounds, prims, 0, 0);
+        _nodes.shrink_to_fit();
+        _primitives.shrink_to_fit();
+
+        _statistics.NumNodes       = _nodes.size();
+        _statistics.NumReferences  = _primitives.size();
+        _statistics.NodeBytes      = _nodes.size() * sizeof(KdTreeNode);
+        _statistics.PrimitiveBytes = _primitives.size() * sizeof(std::uint32_t) + _triangles.size() * sizeof(AccelTriangle);
+        _statistics.BuildTime      = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        spdlog::info(
+            "VCX::Labs::Rendering::KdTree::Build(..): {} triangles ({} references), {} nodes, {} leaves, depth {}, SAH cost {:.2f}, {:.1f} ms.",
+            _statistics.NumTriangles,
+            _statistics.NumReferences,
+            _statistics.NumNodes,
+            _statistics.NumLeaves,
+            _statistics.MaxDepth,
+            _statistics.SAHCost,
+            _statistics.BuildTime);
+    }
+
+    void KdTree::Clear() {
+        _bounds = AABB();
+        _nodes.clear();
+        _primitives.clear();
+        _triangles.clear();
+        _statistics = AccelStatistics();
+    }
+
+    bool KdTree::Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const {
+        if (_nodes.empty()) return false;
+        glm::vec3 const dir    = glm::normalize(ray.Direction);
+        glm::vec3 const invDir = 1.f / dir;
+
+        float tCellMin, tCellMax;
+        if (! _bounds.IntersectRay(ray.Origin, invDir, tMin, tMax, tCellMin, tCellMax)) return false;
+
+        struct Todo {
+            std::uint32_t Node;
+            float         TMin, TMax;
+        };
+        std::array<Todo, c_MaxKdTreeDepth> todo;
+        std::size_t                        top   = 0;
+        std::uint32_t                      idx   = 0;
+        float                              tBest = tMax;
+        bool                               found = false;
+        TraversalTally                     tally;
+        while (tCellMin <= tBest) {
+            KdTreeNode const & node = _nodes[idx];
+            ++tally.Nodes;
+            if (! node.IsLeaf()) {
+                int const     axis       = node.GetAxis();
+                float const   tPlane     = dir[axis] != 0 ? (node.Split - ray.Origin[axis]) * invDir[axis] : std::numeric_limits<float>::infinity();
+                bool const    belowFirst = ray.Origin[axis] < node.Split || (ray.Origin[axis] == node.Split && dir[axis] <= 0);
+                std::uint32_t first      = idx + 1, second = node.GetAboveChild();
+                if (! belowFirst) std::swap(first, second);
+                if (tPlane > tCellMax || tPlane <= 0) {
+                    idx = first;
+                } else if (tPlane < tCellMin) {
+                    idx = second;
+                } else {
+                    todo[top++] = { second, tPlane, tCellMax };
+                    idx         = first;
+                    tCellMax    = tPlane;
+                }
+                continue;
+            }
+            Intersection its;
+            tally.Triangles += node.GetPrimitiveCount();
+            for (std::uint32_t k = 0; k < node.GetPrimitiveCount(); ++k) {
+                AccelTriangle const & tri = _triangles[_primitives[node.PrimitiveOffset + k]];
+                if (! IntersectTriangle(its, ray, tri.P1, tri.P2, tri.P3)) continue;
+                if (its.t < tMin || its.t > tBest) continue;
+                tBest = its.t;
+                hit   = { its.t, its.u, its.v, tri.ModelIndex, tri.FaceIndex };
+                found = true;
+            }
+            if (top == 0) break;
+            --top;
+            idx      = todo[top].Node;
+            tCellMin = todo[top].TMin;
+            tCellMax = todo[top].TMax;
+        }
+        return found;
+    }
+
+    bool KdTree::Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter) const {
+        if (_nodes.empty()) return false;
+        glm::vec3 const dir    = glm::normalize(ray.Direction);
+        glm::vec3 const invDir = 1.f / dir;
+
+        float tCellMin, tCellMax;
+        if (! _bounds.IntersectRay(ray.Origin, invDir, tMin, tMax, tCellMin, tCellMax)) return false;
+
+        // any hit inside [tMin, tMax] will do, so the cells are visited in order without the closest-hit bookkeeping.
+        struct Todo {
+            std::uint32_t Node;
+            float         TMin, TMax;
+        };
+        std::array<Todo, c_MaxKdTreeDepth> todo;
+        std::size_t                        top = 0;
+        std::uint32_t                      idx = 0;
+        TraversalTally                     tally;
+        while (true) {
+            KdTreeNode const & node = _nodes[idx];
+            ++tally.Nodes;
+            if (! node.IsLeaf()) {
+                int const     axis       = node.GetAxis();
+                float const   tPlane     = dir[axis] != 0 ? (node.Split - ray.Origin[axis]) * invDir[axis] : std::numeric_limits<float>::infinity();
+                bool const    belowFirst = ray.Origin[axis] < node.Split || (ray.Origin[axis] == node.Split && dir[axis] <= 0);
+                std::uint32_t first      = idx + 1, second = node.GetAboveChild();
+                if (! belowFirst) std::swap(first, second);
+                if (tPlane > tCellMax || tPlane <= 0) {
+                    idx = first;
+                } else if (tPlane < tCellMin) {
+                    idx = second;
+                } else {
+                    todo[top++] = { second, tPlane, tCellMax };
+                    idx         = first;
+                    tCellMax    = tPlane;
+                }
+                continue;
+            }
+            Intersection its;
+            tally.Triangles += node.GetPrimitiveCount();
+            for (std::uint32_t k = 0; k < node.GetPrimitiveCount(); ++k) {
+                AccelTriangle const & tri = _triangles[_primitives[node.PrimitiveOffset + k]];
+                if (! IntersectTriangle(its, ray, tri.P1, tri.P2, tri.P3)) continue;
+                if (its.t < tMin || its.t > tMax) continue;
+                if (filter({ its.t, its.u, its.v, tri.ModelIndex, tri.FaceIndex })) return true;
+            }
+            if (top == 0) return false;
+            --top;
+            idx      = todo[top].Node;
+            tCellMin = todo[top].TMin;
+            tCellMax = todo[top].TMax;
+        }
+    }
+
+} // namespace VCX::Labs::Rendering
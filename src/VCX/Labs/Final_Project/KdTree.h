@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Engine/Scene.h"
+#include "Labs/Final_Project/Accel.h"
+#include "Labs/Final_Project/Ray.h"
+
+namespace VCX::Labs::Rendering {
+
+    struct KdTreeNode {
+        union {
+            float         Split;           // interior: position of the splitting plane
+            std::uint32_t PrimitiveOffset; // leaf: first entry in the primitive index list
+        };
+        std::uint32_t Flags; // bits 0-1: split axis, or 3 for leaves; bits 2-31: above child (interior) or primitive count (leaf)
+
+        bool          IsLeaf() const { return (Flags & 3) == 3; }
+        int           GetAxis() const { return Flags & 3; }
+        std::uint32_t GetAboveChild() const { return Flags >> 2; } // the below child is the next node
+        std::uint32_t GetPrimitiveCount() const { return Flags >> 2; }
+    };
+
+    struct KdTreeBuildOptions {
+        int   MaxDepth         { 0 }; // 0 selects 8 + 1.3 log2(N)
+        int   MaxLeafSize      { 1 };
+        int   NumBins          { 32 };
+        float TraversalCost    { 1.f };
+        float IntersectionCost { 80.f };
+        float EmptyBonus       { .5f }; // cost reduction for splits that cut off empty space
+
+        bool operator==(KdTreeBuildOptions const &) const = default;
+    };
+
+    class KdTree {
+    public:
+        void Build(Engine::Scene const & scene, KdTreeBuildOptions const & options = { });
+        void Clear();
+
+        bool IsEmpty() const { return _nodes.empty(); }
+
+        // closest hit with t in [tMin, tMax], t is measured along the normalized ray direction.
+        bool Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const;
+
+        // whether any hit with t in [tMin, tMax] passes filter, stops at the first one.
+        bool Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter = { }) const;
+
+        AccelStatistics const & GetStatistics() const { return _statistics; }
+
+    private:
+        AABB                       _bounds;
+        std::vector<KdTreeNode>    _nodes;
+        std::vector<std::uint32_t> _primitives;
+        std::vector<AccelTriangle> _triangles;
+        AccelStatistics            _statistics;
+    };
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Labs/Final_Project/PreviewRenderer.h"
+
+namespace VCX::Labs::Rendering {
+
+    static bool IsSameView(Engine::Camera const & a, Engine::Camera const & b) {
+        return a.Eye == b.Eye && a.Target == b.Target && a.Up == b.Up && a.Fovy == b.Fovy;
+    }
+
+    PreviewRenderer::PreviewRenderer() {
+        // started once every member it touches exists.
+        _thread = std::thread([this]() { Run(); });
+    }
+
+    PreviewRenderer::~PreviewRenderer() {
+        {
+            std::lock_guard lock(_mutex);
+            _quit = true;
+            _token.Cancel();
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    void PreviewRenderer::Request(
+        Engine::Camera const &                        camera,
+        std::pair<std::uint32_t, std::uint32_t> const size,
+        TileRenderOptions const &                     options,
+        PrepareFunc                                   prepare,
+        TraceFunc                                     trace) {
+        {
+            std::lock_guard lock(_mutex);
+            if (_hasLast && _job.Size == size && IsSameView(_job.Camera, camera)) return;
+            _job     = { camera, size, options, std::move(prepare), std::move(trace) };
+            _hasJob  = true;
+            _hasLast = true;
+            _token.Cancel();
+        }
+        _wake.notify_all();
+    }
+
+    void PreviewRenderer::Cancel() {
+        std::lock_guard lock(_mutex);
+        _hasJob    = false;
+        _hasLast   = false;
+        _published = false;
+        _token.Cancel();
+    }
+
+    void PreviewRenderer::Stop() {
+        Cancel();
+        std::unique_lock lock(_mutex);
+        _idle.wait(lock, [&]() { return ! _busy; });
+    }
+
+    void PreviewRenderer::Run() {
+        std::unique_lock lock(_mutex);
+        while (true) {
+            _wake.wait(lock, [&]() { return _quit || _hasJob; });
+            if (_quit) return;
+            Job const job   = _job;
+            _hasJob         = false;
+            _busy           = true;
+            _token          = Engine::CancellationToken();
+            _finishedLevels = 0;
+            // requests cancel _token, which stays the token of this job until the next one replaces it.
+            Engine::CancellationToken const token = _token;
+            lock.unlock();
+
+            if (job.Prepare) job.Prepare();
+            _renderer.Options = job.Options;
+            auto const &    camera    = job.Camera;
+            glm::vec3 const lookDir   = glm::normalize(camera.Target - camera.Eye);
+            glm::vec3 const rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+            glm::vec3 const upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+            float const     fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+            for (int level = 0; level < NumLevels && ! token.IsCancelled(); ++level) {
+                // 1/4, 1/2, then all of the pixels along each axis.
+                std::uint32_t const scale  = 1u << (NumLevels - 1 - level);
+                std::uint32_t const width  = std::max(1u, (job.Size.first + scale - 1) / scale);
+                std::uint32_t const height = std::max(1u, (job.Size.second + scale - 1) / scale);
+                float const         aspect = width * 1.f / height;
+                Common::ImageRGB    image(width, height);
+                _renderer.Reset();
+                bool const finished = _renderer.Render(
+                    image,
+                    [&](std::size_t const i, std::size_t const j) {
+                        glm::vec3 dir = lookDir;
+                        dir += fovFactor * (2.0f * (j + .5f) / height - 1.0f) * upDir;
+                        dir += fovFactor * aspect * (2.0f * (i + .5f) / width - 1.0f) * rightDir;
+                        return job.Trace(Ray(camera.Eye, glm::normalize(dir)), i, j);
+                    },
+                    token);
+                if (! finished) break;
+                {
+                    // under the request lock, so that a pass cancelled after it finished is still dropped.
+                    std::lock_guard jobLock(_mutex);
+                    if (token.IsCancelled()) break;
+                    std::lock_guard imageLock(_imageMutex);
+                    _image          = std::move(image);
+                    _finishedLevels = level + 1;
+                    _published      = true;
+                }
+            }
+
+            lock.lock();
+            _busy = false;
+            _idle.notify_all();
+        }
+    }
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "Engine/Camera.hpp"
+#include "Labs/Common/ImageRGB.h"
+#include "Labs/Final_Project/Ray.h"
+#include "Labs/Final_Project/TileRenderer.h"
+
+namespace VCX::Labs::Rendering {
+
+    // ray-traced stand-in for the wireframe view while the camera moves. every new camera or view size starts over at
+    // 1/16 of the pixels, then 1/4, then all of them; a pass still running for an old camera is cancelled right away.
+    // only finished passes are published, so the view never shows a half-traced image. whatever prepare and trace
+    // read comes with the request, the preview threads never read the state the UI edits.
+    class PreviewRenderer {
+    public:
+        using PrepareFunc = std::function<void()>;
+        using TraceFunc   = std::function<glm::vec3(Ray const & ray, std::size_t const x, std::size_t const y)>;
+
+        static constexpr int NumLevels = 3;
+
+        PreviewRenderer();
+        ~PreviewRenderer();
+
+        // restarts from the coarsest pass if camera or size differ from the last request, otherwise returns at once.
+        // both functions run on the preview threads: prepare once before tracing, e.g. to build the scene, and trace
+        // for the display color of a primary ray, x and y in pixels of the current pass. they are only taken when the
+        // request restarts, so call Cancel() whenever what they capture changes.
+        void Request(
+            Engine::Camera const &                        camera,
+            std::pair<std::uint32_t, std::uint32_t> const size,
+            TileRenderOptions const &                     options,
+            PrepareFunc                                   prepare,
+            TraceFunc                                     trace);
+
+        // cancels the running pass without waiting, the next Request(..) starts over and nothing is published until then.
+        // a prepare already running is left to finish in the background.
+        void Cancel();
+
+        // Cancel(), then waits for the preview to go idle. call before anything the preview traces changes, e.g. before
+        // the intersector is rebuilt; it may wait for a whole prepare, so not from the UI thread.
+        void Stop();
+
+        // runs upload(image) under the image lock if a pass finished since the last call.
+        template<typename Func>
+        void SyncImage(Func && upload) {
+            if (! _published.exchange(false)) return;
+            std::lock_guard lock(_imageMutex);
+            upload(_image);
+        }
+
+        // passes finished for the last request, NumLevels once the preview is at full resolution.
+        int GetFinishedLevels() const { return _finishedLevels.load(std::memory_order_relaxed); }
+
+    private:
+        struct Job {
+            Engine::Camera                          Camera;
+            std::pair<std::uint32_t, std::uint32_t> Size;
+            TileRenderOptions                       Options;
+            PrepareFunc                             Prepare;
+            TraceFunc                               Trace;
+        };
+
+        void Run();
+
+        TileRenderer              _renderer;
+        std::thread               _thread;
+        std::mutex                _mutex;
+        std::condition_variable   _wake;
+        std::condition_variable   _idle;
+        Job                       _job;               // last request
+        bool                      _hasJob { false };  // _job waits for the thread
+        bool                      _hasLast { false }; // _job is valid and not stopped, so equal requests can be skipped
+        bool                      _busy { false };
+        bool                      _quit { false };
+        Engine::CancellationToken _token;             // of the job running, cancelled by the next request
+
+        Common::ImageRGB  _image; // last finished pass
+        std::mutex        _imageMutex;
+        std::atomic<bool> _published { false };
+        std::atomic<int>  _finishedLevels { 0 };
+    };
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <fstream>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "Labs/Final_Project/RayStatistics.h"
+
+namespace VCX::Labs::Rendering {
+
+    RayCounts & RayCounts::operator+=(RayCounts const & o) {
+        CameraRays += o.CameraRays;
+        BounceRays += o.BounceRays;
+        ShadowRays += o.ShadowRays;
+        NodesVisited += o.NodesVisited;
+        TrianglesTested += o.TrianglesTested;
+        Paths += o.Paths;
+        PathVertices += o.PathVertices;
+        RouletteTerminations += o.RouletteTerminations;
+        return *this;
+    }
+
+    void RayStatistics::AddPass(double const seconds) const {
+        _numPasses.fetch_add(1, std::memory_order_relaxed);
+        _passTime.fetch_add(seconds, std::memory_order_relaxed);
+        _lastPassTime.store(seconds, std::memory_order_relaxed);
+    }
+
+    RayCounts RayStatistics::Gather() const {
+        RayCounts total;
+        for (auto const & counts : GatherPerThread()) total += counts;
+        return total;
+    }
+
+    RayCounts RayStatistics::Load(Slot const & slot) {
+        RayCounts counts;
+        counts.CameraRays           = slot.CameraRays.load(std::memory_order_relaxed);
+        counts.BounceRays           = slot.BounceRays.load(std::memory_order_relaxed);
+        counts.ShadowRays           = slot.ShadowRays.load(std::memory_order_relaxed);
+        counts.NodesVisited         = slot.NodesVisited.load(std::memory_order_relaxed);
+        counts.TrianglesTested      = slot.TrianglesTested.load(std::memory_order_relaxed);
+        counts.Paths                = slot.Paths.load(std::memory_order_relaxed);
+        counts.PathVertices         = slot.PathVertices.load(std::memory_order_relaxed);
+        counts.RouletteTerminations = slot.RouletteTerminations.load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    std::vector<RayCounts> RayStatistics::GatherPerThread() const {
+        std::vector<RayCounts> counts(_slots.size());
+        for (std::size_t i = 0; i < _slots.size(); ++i) counts[i] = Load(_slots[i]);
+        // lines past the last thread that traced anything stay out of the dump.
+        while (! counts.empty() && counts.back().GetRays() == 0 && counts.back().Paths == 0) counts.pop_back();
+        return counts;
+    }
+
+    void RayStatistics::Reset() {
+        for (auto & slot : _slots) {
+            slot.CameraRays.store(0, std::memory_order_relaxed);
+            slot.BounceRays.store(0, std::memory_order_relaxed);
+            slot.ShadowRays.store(0, std::memory_order_relaxed);
+            slot.NodesVisited.store(0, std::memory_order_relaxed);
+            slot.TrianglesTested.store(0, std::memory_order_relaxed);
+            slot.Paths.store(0, std::memory_order_relaxed);
+            slot.PathVertices.store(0, std::memory_order_relaxed);
+            slot.RouletteTerminations.store(0, std::memory_order_relaxed);
+        }
+        _numPasses.store(0, std::memory_order_relaxed);
+        _passTime.store(0, std::memory_order_relaxed);
+        _lastPassTime.store(0, std::memory_order_relaxed);
+    }
+
+    static std::string FormatCounts(RayCounts const & counts) {
+        double const rays = double(std::max<std::uint64_t>(counts.GetRays(), 1));
+        return fmt::format(
+            "\"camera_rays\": {}, \"bounce_rays\": {}, \"shadow_rays\": {}, \"nodes_visited\": {}, \"triangles_tested\": {}, "
+            "\"paths\": {}, \"path_vertices\": {}, \"roulette_terminations\": {}, "
+            "\"nodes_per_ray\": {:.3f}, \"triangles_per_ray\": {:.3f}, \"average_path_length\": {:.4f}",
+            counts.CameraRays,
+            counts.BounceRays,
+            counts.ShadowRays,
+            counts.NodesVisited,
+            counts.TrianglesTested,
+            counts.Paths,
+            counts.PathVertices,
+            counts.RouletteTerminations,
+            counts.NodesVisited / rays,
+            counts.TrianglesTested / rays,
+            counts.GetAveragePathLength());
+    }
+
+    bool WriteRayStatistics(std::filesystem::path const & fileName, RayStatistics const & statistics) {
+        std::ofstream file(fileName);
+        if (! file) {
+            spdlog::error("VCX::Labs::Rendering::WriteRayStatistics(\"{}\"): cannot write.", fileName.string());
+            return false;
+        }
+        RayCounts const total    = statistics.Gather();
+        double const    passTime = statistics.GetPassTime();
+        file << "{\n  \"version\": 2,\n";
+        file << "  \"total\": { " << FormatCounts(total) << " },\n";
+        file << fmt::format(
+            "  \"passes\": {{ \"count\": {}, \"seconds\": {:.6f}, \"last_seconds\": {:.6f}, \"mrays_per_s\": {:.4f} }},\n",
+            statistics.GetNumPasses(),
+            passTime,
+            statistics.GetLastPassTime(),
+            passTime > 0 ? total.GetRays() * 1e-6 / passTime : 0.);
+        file << fmt::format(
+            "  \"thread_slots\": {{ \"count\": {}, \"slot\": \"process-wide thread number modulo count, threads count apart share a slot; "
+            "slots nothing was traced in are left out\" }},\n",
+            RayStatistics::MaxThreads);
+        file << "  \"threads\": [";
+        auto const threads = statistics.GatherPerThread();
+        bool       first   = true;
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            if (threads[i].GetRays() == 0 && threads[i].Paths == 0) continue;
+            file << (first ? "\n" : ",\n") << "    { \"slot\": " << i << ", " << FormatCounts(threads[i]) << " }";
+            first = false;
+        }
+        file << "\n  ]\n}\n";
+        return true;
+    }
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace VCX::Labs::Rendering {
+
+    enum class RayType {
+        Camera,
+        Bounce, // closest-hit rays after the first vertex of a path
+        Shadow,
+    };
+
+    struct RayCounts {
+        std::uint64_t CameraRays           { 0 };
+        std::uint64_t BounceRays           { 0 };
+        std::uint64_t ShadowRays           { 0 };
+        std::uint64_t NodesVisited         { 0 }; // popped off the traversal stacks, leaves included
+        std::uint64_t TrianglesTested      { 0 }; // 8 per block in the wide BVH layouts, padding lanes included
+        std::uint64_t Paths                { 0 };
+        std::uint64_t PathVertices         { 0 }; // surface hits over all paths
+        std::uint64_t RouletteTerminations { 0 };
+
+        std::uint64_t GetRays() const { return CameraRays + BounceRays + ShadowRays; }
+        double        GetAveragePathLength() const { return Paths ? double(PathVertices) / Paths : 0; }
+
+        RayCounts & operator+=(RayCounts const & o);
+    };
+
+    // counters bumped on the hot path of every tracing thread. each thread adds to its own cache line,
+    // so they cost no contention; Gather() sums the lines and is only approximate while tracing goes on.
+    class RayStatistics {
+    public:
+        static constexpr std::size_t MaxThreads = 64; // threads this many apart share a line, still counted exactly
+
+        void AddRay(RayType const type, std::uint64_t const nodes, std::uint64_t const triangles) const {
+            Slot & slot = GetSlot();
+            (type == RayType::Camera ? slot.CameraRays : type == RayType::Bounce ? slot.BounceRays : slot.ShadowRays).fetch_add(1, std::memory_order_relaxed);
+            slot.NodesVisited.fetch_add(nodes, std::memory_order_relaxed);
+            slot.TrianglesTested.fetch_add(triangles, std::memory_order_relaxed);
+        }
+
+        // vertices is the number of surfaces the path hit.
+        void AddPath(std::uint32_t const vertices, bool const roulette) const {
+            Slot & slot = GetSlot();
+            slot.Paths.fetch_add(1, std::memory_order_relaxed);
+            slot.PathVertices.fetch_add(vertices, std::memory_order_relaxed);
+            if (roulette) slot.RouletteTerminations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // by the render loop once a pass over the whole image finished.
+        void AddPass(double const seconds) const;
+
+        RayCounts Gather() const;
+        // indexed by slot, i.e. by the process-wide number of a thread modulo MaxThreads: threads that never traced,
+        // e.g. the UI thread, leave empty slots in between, and threads MaxThreads apart add to the same slot.
+        std::vector<RayCounts> GatherPerThread() const;
+
+        int    GetNumPasses() const { return _numPasses.load(std::memory_order_relaxed); }
+        double GetPassTime() const { return _passTime.load(std::memory_order_relaxed); } // of all finished passes, in seconds
+        double GetLastPassTime() const { return _lastPassTime.load(std::memory_order_relaxed); }
+
+        // only exact while nothing is traced.
+        void Reset();
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<std::uint64_t> CameraRays { 0 };
+            std::atomic<std::uint64_t> BounceRays { 0 };
+            std::atomic<std::uint64_t> ShadowRays { 0 };
+            std::atomic<std::uint64_t> NodesVisited { 0 };
+            std::atomic<std::uint64_t> TrianglesTested { 0 };
+            std::atomic<std::uint64_t> Paths { 0 };
+            std::atomic<std::uint64_t> PathVertices { 0 };
+            std::atomic<std::uint64_t> RouletteTerminations { 0 };
+        };
+
+        // dense per-process thread numbers, so the pool threads land on distinct lines.
+        static std::size_t GetThreadIndex() {
+            static std::atomic<std::size_t> next { 0 };
+            thread_local std::size_t const  index = next.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+
+        Slot & GetSlot() const { return _slots[GetThreadIndex() % MaxThreads]; }
+
+        static RayCounts Load(Slot const & slot);
+
+        mutable std::array<Slot, MaxThreads> _slots;
+        mutable std::atomic<int>             _numPasses { 0 };
+        mutable std::atomic<double>          _passTime { 0 };
+        mutable std::atomic<double>          _lastPassTime { 0 };
+    };
+
+    // machine-readable dump of the totals, the per-slot counts of GatherPerThread() and the pass times.
+    // returns false, with an error emitted to spdlog, if the file cannot be written.
+    bool WriteRayStatistics(std::filesystem::path const & fileName, RayStatistics const & statistics);
+
+} // namespace VCX::Labs::Rendering
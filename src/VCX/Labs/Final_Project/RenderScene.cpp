@@ -0,0 +1,51 @@
+#include <chrono>
+
+#include <spdlog/spdlog.h>
+
+#include "Engine/Trace.h"
+#include "Labs/Final_Project/RenderScene.h"
+
+namespace VCX::Labs::Rendering {
+
+    static bool HasTranslucentTexels(Engine::Texture2D<Engine::Formats::RGBA8> const & texture) {
+        auto const bytes = texture.GetBytes();
+        for (std::size_t i = 3; i < bytes.size(); i += 4)
+            if (std::to_integer<std::uint8_t>(bytes[i]) < 255) return true;
+        return false;
+    }
+
+    void RenderScene::Build(Engine::Scene const & scene) {
+        Engine::TraceScope const trace("BuildRenderScene", "build");
+        auto const               start = std::chrono::steady_clock::now();
+        Clear();
+        _models.resize(scene.Models.size());
+        std::size_t numComputed = 0;
+        for (std::size_t i = 0; i < scene.Models.size(); ++i) {
+            Engine::SurfaceMesh const & mesh  = scene.Models[i].Mesh;
+            RenderModel &               model = _models[i];
+            model.Mesh                        = &mesh;
+            model.Material                    = &scene.Materials[scene.Models[i].MaterialIndex];
+            model.Normals                     = mesh.IsNormalAvailable() ? mesh.Normals : mesh.ComputeNormals();
+            model.TexCoords                   = mesh.IsTexCoordAvailable() ? mesh.TexCoords : mesh.GetEmptyTexCoords();
+            model.Translucent                 = HasTranslucentTexels(model.Material->Albedo);
+            numComputed += ! mesh.IsNormalAvailable();
+
+            model.FaceNormals.resize(mesh.Indices.size() / 3);
+            for (std::size_t j = 0; j + 2 < mesh.Indices.size(); j += 3) {
+                std::uint32_t const * face = mesh.Indices.data() + j;
+                glm::vec3 const       n    = glm::cross(mesh.Positions[face[1]] - mesh.Positions[face[0]], mesh.Positions[face[2]] - mesh.Positions[face[0]]);
+                float const           len  = glm::length(n);
+                model.FaceNormals[j / 3]   = len > 0 ? n / len : glm::vec3(0);
+            }
+        }
+        spdlog::info("VCX::Labs::Rendering::RenderScene::Build(..): {} models ({} with computed normals), {:.1f} ms.",
+            _models.size(),
+            numComputed,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void RenderScene::Clear() {
+        _models.clear();
+    }
+
+} // namespace VCX::Labs::Rendering
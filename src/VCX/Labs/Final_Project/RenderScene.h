@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Engine/Scene.h"
+
+namespace VCX::Labs::Rendering {
+
+    // a model with every attribute the renderers read, filled in once when the scene is loaded.
+    struct RenderModel {
+        Engine::SurfaceMesh const * Mesh     { nullptr }; // positions and indices are read in place
+        Engine::Material const *    Material { nullptr };
+        std::vector<glm::vec3>      Normals;               // per vertex, computed when the mesh has none
+        std::vector<glm::vec2>      TexCoords;             // per vertex, zero when the mesh has none
+        std::vector<glm::vec3>      FaceNormals;           // per triangle, normalized, zero for degenerate ones
+        bool                        Translucent { false }; // some albedo texel has alpha below 255
+    };
+
+    // render-ready view of an Engine::Scene, hits refer to it by model index and face index.
+    // the scene must outlive it and keep its meshes unchanged.
+    class RenderScene {
+    public:
+        void Build(Engine::Scene const & scene);
+        void Clear();
+
+        bool                IsEmpty() const { return _models.empty(); }
+        std::size_t         GetModelCount() const { return _models.size(); }
+        RenderModel const & GetModel(std::size_t const modelIdx) const { return _models[modelIdx]; }
+
+    private:
+        std::vector<RenderModel> _models;
+    };
+
+} // namespace VCX::Labs::Rendering
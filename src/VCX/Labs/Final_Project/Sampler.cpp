@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "Assets/bundled.h"
+#include "Engine/loader.h"
+#include "Labs/Final_Project/Sampler.h"
+
+namespace VCX::Labs::Rendering {
+
+    static std::uint32_t Hash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        return x ^ (x >> 16);
+    }
+
+    static std::uint32_t HashCombine(std::uint32_t const seed, std::uint32_t const v) {
+        return seed ^ (Hash(v) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
+    static std::uint32_t ReverseBits(std::uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // Owen scrambling as a hash over the bit-reversed value (Laine and Karras; Burley, "Practical Hash-based Owen Scrambling"):
+    // every bit is flipped depending only on the bits above it.
+    static std::uint32_t NestedUniformScramble(std::uint32_t x, std::uint32_t const seed) {
+        x = ReverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return ReverseBits(x);
+    }
+
+    // second Sobol dimension, its direction numbers are v_0 = 1 / 2 and v_k = v_{k - 1} ^ (v_{k - 1} / 2).
+    static std::uint32_t Sobol1(std::uint32_t index) {
+        std::uint32_t result = 0;
+        for (std::uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+            if (index & 1) result ^= v;
+        return result;
+    }
+
+    static float ToFloat(std::uint32_t const x) { return float(x >> 8) * 0x1p-24f; }
+
+    static constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
+    static bool IsPrime(std::uint32_t const n) {
+        for (std::uint32_t d = 2; d * d <= n; ++d)
+            if (n % d == 0) return false;
+        return true;
+    }
+
+    RadicalInverse::RadicalInverse(bool const scrambled) {
+        PCG32         rng(0x5eed, 7);
+        std::uint32_t candidate = 2;
+        for (auto & table : _bases) {
+            while (! IsPrime(candidate)) ++candidate;
+            std::uint32_t const base = candidate++;
+
+            table.Base = base;
+            if (base == 2) {
+                // a permutation of a binary digit either keeps or flips it.
+                table.BlockSize = 0;
+                table.NumBlocks = 0;
+                table.Mask      = scrambled ? rng.NextUInt() : 0;
+                continue;
+            }
+            int           digitsPerBlock = 0;
+            std::uint32_t blockSize      = 1;
+            while (blockSize * base <= 1024) {
+                blockSize *= base;
+                ++digitsPerBlock;
+            }
+            int numDigits = 0;
+            for (std::uint64_t power = 1; power <= 0xffffffffull; power *= base) ++numDigits;
+            table.BlockSize = blockSize;
+            table.NumBlocks = (numDigits + digitsPerBlock - 1) / digitsPerBlock;
+            table.Blocks.resize(std::size_t(table.NumBlocks) * blockSize);
+
+            std::vector<std::uint32_t> permutation(base);
+            double                     scale = 1;
+            for (int l = 0; l < table.NumBlocks; ++l) {
+                std::vector<double> row(blockSize, 0.);
+                std::uint32_t       stride = 1;
+                for (int k = 0; k < digitsPerBlock; ++k, stride *= base) {
+                    scale /= base;
+                    std::iota(permutation.begin(), permutation.end(), 0u);
+                    if (scrambled)
+                        for (std::uint32_t i = base - 1; i > 0; --i)
+                            std::swap(permutation[i], permutation[rng.NextUInt() % (i + 1)]);
+                    for (std::uint32_t v = 0; v < blockSize; ++v)
+                        row[v] += permutation[v / stride % base] * scale;
+                }
+                std::copy(row.begin(), row.end(), table.Blocks.begin() + std::size_t(l) * blockSize);
+            }
+        }
+    }
+
+    RadicalInverse const & RadicalInverse::GetPlain() {
+        static RadicalInverse const plain(false);
+        return plain;
+    }
+
+    RadicalInverse const & RadicalInverse::GetScrambled() {
+        static RadicalInverse const scrambled(true);
+        return scrambled;
+    }
+
+    int RadicalInverse::FindBase(std::uint32_t const base) {
+        auto const & bases = GetPlain()._bases;
+        for (int i = 0; i < NumBases; ++i)
+            if (bases[i].Base == base) return i;
+        return -1;
+    }
+
+    float RadicalInverse::GetHigh(BaseTable const & table, std::uint32_t q) const {
+        float high = 0;
+        for (int l = 1; l < table.NumBlocks; ++l) {
+            high += table.Blocks[std::size_t(l) * table.BlockSize + q % table.BlockSize];
+            q /= table.BlockSize;
+        }
+        return high;
+    }
+
+    float RadicalInverse::operator()(int const baseIndex, std::uint32_t const index) const {
+        BaseTable const & table = _bases[baseIndex];
+        if (table.Base == 2) return ToFloat(ReverseBits(index) ^ table.Mask);
+        return std::min(table.Blocks[index % table.BlockSize] + GetHigh(table, index / table.BlockSize), OneMinusEpsilon);
+    }
+
+    void RadicalInverse::Generate(int const baseIndex, std::uint32_t const first, std::uint32_t const count, float * const out) const {
+        BaseTable const & table = _bases[baseIndex];
+        if (table.Base == 2) {
+            for (std::uint32_t i = 0; i < count; ++i) out[i] = ToFloat(ReverseBits(first + i) ^ table.Mask);
+            return;
+        }
+        std::uint32_t r    = first % table.BlockSize;
+        std::uint32_t q    = first / table.BlockSize;
+        float         high = GetHigh(table, q);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            out[i] = std::min(table.Blocks[r] + high, OneMinusEpsilon);
+            if (++r == table.BlockSize) {
+                r    = 0;
+                high = GetHigh(table, ++q);
+            }
+        }
+    }
+
+    void HaltonBatch::Generate(std::uint32_t const firstIndex, std::uint32_t const numIndices, int const numDimensions) {
+        auto const & inverse = RadicalInverse::GetScrambled();
+        _firstIndex          = firstIndex;
+        _numIndices          = numIndices;
+        _numDimensions       = std::min(numDimensions, RadicalInverse::NumBases / 2);
+        _points.resize(std::size_t(_numIndices) * _numDimensions);
+        std::vector<float> u(_numIndices), v(_numIndices);
+        for (int d = 0; d < _numDimensions; ++d) {
+            inverse.Generate(2 * d, _firstIndex, _numIndices, u.data());
+            inverse.Generate(2 * d + 1, _firstIndex, _numIndices, v.data());
+            for (std::uint32_t i = 0; i < _numIndices; ++i) _points[std::size_t(i) * _numDimensions + d] = { u[i], v[i] };
+        }
+    }
+
+    // the first two Sobol dimensions form a (0, 2)-sequence, so every 2D draw gets its own padded copy of them.
+    // scrambling the index with the same seed shuffles the points, which keeps dimensions sharing a seed prefix uncorrelated.
+    static glm::vec2 SobolOwen2D(std::uint32_t index, std::uint32_t const seed) {
+        index = NestedUniformScramble(index, seed);
+        return {
+            ToFloat(NestedUniformScramble(ReverseBits(index), HashCombine(seed, 0))),
+            ToFloat(NestedUniformScramble(Sobol1(index), HashCombine(seed, 1))),
+        };
+    }
+
+    struct BlueNoiseMask {
+        std::vector<float> Values; // texel centers in [0, 1)
+        std::size_t        Size { 0 };
+
+        BlueNoiseMask() {
+            auto const image = Engine::LoadImageGray(Assets::BlueNoiseImage);
+            if (image.GetSizeX() == 0 || image.GetSizeX() != image.GetSizeY()) {
+                spdlog::warn("VCX::Labs::Rendering::BlueNoiseMask(..): cannot load \"{}\", falling back to white noise.", Assets::BlueNoiseImage);
+                return;
+            }
+            Size = image.GetSizeX();
+            Values.resize(Size * Size);
+            for (std::size_t y = 0; y < Size; ++y)
+                for (std::size_t x = 0; x < Size; ++x)
+                    Values[y * Size + x] = (std::round(image.At(x, y) * 255.f) + .5f) / 256.f;
+        }
+
+        static BlueNoiseMask const & Get() {
+            static BlueNoiseMask const mask;
+            return mask;
+        }
+
+        // the mask is tiled over the image, each dimension reads it at a different offset along the R2 sequence
+        // so that the dimensions of one pixel are not all rotated by the same amount.
+        glm::vec2 Sample(std::uint32_t const x, std::uint32_t const y, std::uint32_t const dimension) const {
+            auto const At = [&](std::uint32_t const k) {
+                std::size_t const ox = std::size_t(k * 0.7548776662f * Size);
+                std::size_t const oy = std::size_t(k * 0.5698402910f * Size);
+                return Values[((y + oy) % Size) * Size + (x + ox) % Size];
+            };
+            return { At(2 * dimension + 1), At(2 * dimension + 2) };
+        }
+    };
+
+    Sampler::Sampler(SamplerType const type, std::uint32_t const x, std::uint32_t const y, std::uint32_t const sampleIndex, HaltonBatch const * const batch):
+        _type(type),
+        _x(x),
+        _y(y),
+        _index(sampleIndex),
+        _seed(HashCombine(Hash(x), y)),
+        _rng((std::uint64_t(y) << 32) | x, sampleIndex),
+        _batch(batch) {
+        if (_type == SamplerType::BlueNoise && BlueNoiseMask::Get().Size == 0) _type = SamplerType::Independent;
+    }
+
+    void Sampler::LoadBlueNoise() {
+        BlueNoiseMask::Get();
+    }
+
+    float Sampler::Get1D() {
+        if (_type == SamplerType::Independent) return _rng.NextFloat();
+        return Get2D().x;
+    }
+
+    glm::vec2 Sampler::Get2D() {
+        std::uint32_t const dimension = _dimension++;
+        switch (_type) {
+        case SamplerType::Halton:
+            if (dimension < RadicalInverse::NumBases / 2) {
+                // every pixel shares the sequence, the shift keeps neighbours from sharing a pattern.
+                std::uint32_t const hash = HashCombine(_seed, dimension);
+                glm::vec2 const     shift(float(hash & 0xffff) / 65536.f, float(hash >> 16) / 65536.f);
+                if (_batch && _batch->Contains(_index, dimension)) return glm::fract(_batch->Get(_index, dimension) + shift);
+                auto const & inverse = RadicalInverse::GetScrambled();
+                return glm::fract(glm::vec2(inverse(2 * dimension, _index), inverse(2 * dimension + 1, _index)) + shift);
+            }
+            break;
+        case SamplerType::Sobol:
+            return SobolOwen2D(_index, HashCombine(_seed, dimension));
+        case SamplerType::BlueNoise:
+            // every pixel walks the same sequence, so the per-pixel rotations alone decide how the error is spread.
+            return glm::fract(SobolOwen2D(_index, Hash(dimension)) + BlueNoiseMask::Get().Sample(_x, _y, dimension));
+        default:
+            break;
+        }
+        float const u = _rng.NextFloat();
+        return { u, _rng.NextFloat() };
+    }
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace VCX::Labs::Rendering {
+
+    // PCG32 (XSH RR): 16 bytes of state and two steps to seed, cheap enough to create one per camera sample.
+    // keyed by (pixel, sample) it gives every sample its own stream whose n-th draw is the n-th dimension,
+    // so a render does not depend on which thread traced which sample.
+    class PCG32 {
+    public:
+        PCG32(std::uint64_t const seed, std::uint64_t const stream = 0) {
+            _increment = (stream << 1) | 1;
+            NextUInt();
+            _state += seed;
+            NextUInt();
+        }
+
+        std::uint32_t NextUInt() {
+            std::uint64_t const state = _state;
+            _state                    = state * 6364136223846793005ull + _increment;
+            return std::rotr(std::uint32_t(((state >> 18) ^ state) >> 27), int(state >> 59));
+        }
+
+        // uniform in [0, 1).
+        float NextFloat() { return float(NextUInt() >> 8) * 0x1p-24f; }
+
+    private:
+        std::uint64_t _state { 0 };
+        std::uint64_t _increment;
+    };
+
+    enum class SamplerType {
+        Independent, // PCG32 for every dimension
+        Halton,      // Halton with scrambled digits, shifted per pixel, PCG32 beyond the tabulated bases
+        Sobol,       // Owen-scrambled Sobol (0, 2)-sequence, scrambled and shuffled per pixel and dimension
+        BlueNoise,   // one Owen-scrambled Sobol sequence for the whole image, rotated per pixel by a blue noise mask
+    };
+
+    // radical inverses in the first NumBases primes. every base tabulates the inverse of all values of a block of
+    // digits, so an index costs one lookup and one division per block instead of one division per digit;
+    // base 2 needs neither and reverses the bits. scrambled tables permute each digit position randomly.
+    class RadicalInverse {
+    public:
+        static constexpr int NumBases = 64;
+
+        static RadicalInverse const & GetPlain();
+        static RadicalInverse const & GetScrambled(); // fixed permutations, renders stay reproducible
+
+        // index of base among the tabulated primes, or -1.
+        static int FindBase(std::uint32_t const base);
+
+        std::uint32_t GetBase(int const baseIndex) const { return _bases[baseIndex].Base; }
+
+        // in [0, 1).
+        float operator()(int const baseIndex, std::uint32_t const index) const;
+
+        // the inverses of count consecutive indices, the blocks above the lowest are only looked up when they change.
+        void Generate(int const baseIndex, std::uint32_t const first, std::uint32_t const count, float * const out) const;
+
+    private:
+        struct BaseTable {
+            std::uint32_t      Base;
+            std::uint32_t      BlockSize;  // Base^(digits per block)
+            int                NumBlocks;  // enough for every 32-bit index
+            std::uint32_t      Mask { 0 }; // base 2: xor applied to the reversed bits
+            std::vector<float> Blocks;     // NumBlocks rows of BlockSize inverses, row l already scaled by BlockSize^-l
+        };
+
+        explicit RadicalInverse(bool const scrambled);
+
+        float GetHigh(BaseTable const & table, std::uint32_t q) const; // sum of the blocks above the lowest
+
+        std::array<BaseTable, NumBases> _bases;
+    };
+
+    // scrambled Halton points of a range of sample indices for the first few dimensions, generated once per pass
+    // and shared by every pixel. Sampler falls back to RadicalInverse for whatever the batch does not cover.
+    class HaltonBatch {
+    public:
+        void Generate(std::uint32_t const firstIndex, std::uint32_t const numIndices, int const numDimensions);
+
+        bool Contains(std::uint32_t const index, std::uint32_t const dimension) const {
+            return index - _firstIndex < _numIndices && dimension < std::uint32_t(_numDimensions);
+        }
+
+        glm::vec2 Get(std::uint32_t const index, std::uint32_t const dimension) const { return _points[(index - _firstIndex) * _numDimensions + dimension]; }
+
+    private:
+        std::uint32_t          _firstIndex { 0 };
+        std::uint32_t          _numIndices { 0 };
+        int                    _numDimensions { 0 };
+        std::vector<glm::vec2> _points; // index-major
+    };
+
+    // all random numbers of one camera sample. every Get1D() or Get2D() call takes the next dimension,
+    // the first one is the pixel jitter and the path decides the rest, so it has to draw them in a fixed order.
+    class Sampler {
+    public:
+        Sampler(SamplerType const type, std::uint32_t const x, std::uint32_t const y, std::uint32_t const sampleIndex, HaltonBatch const * const batch = nullptr);
+
+        float     Get1D();
+        glm::vec2 Get2D();
+
+        // loads the blue noise mask ahead of the first BlueNoise sample, safe to call more than once.
+        static void LoadBlueNoise();
+
+    private:
+        SamplerType         _type;
+        std::uint32_t       _x;
+        std::uint32_t       _y;
+        std::uint32_t       _index;
+        std::uint32_t       _seed; // hash of the pixel
+        std::uint32_t       _dimension { 0 };
+        PCG32               _rng;
+        HaltonBatch const * _batch;
+    };
+
+} // namespace VCX::Labs::Rendering
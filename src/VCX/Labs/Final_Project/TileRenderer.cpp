@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <bit>
+#include <latch>
+#include <thread>
+
+#include "Engine/Trace.h"
+#include "Labs/Common/RenderScheduler.h"
+#include "Labs/Final_Project/TileRenderer.h"
+
+namespace VCX::Labs::Rendering {
+
+    // d-th point of the curve filling an n x n grid, n a power of two.
+    static glm::uvec2 GetCurvePoint(TraversalOrder const order, std::uint32_t const n, std::uint32_t d) {
+        if (order == TraversalOrder::Morton) {
+            glm::uvec2 p(0);
+            for (std::uint32_t bit = 0; d; ++bit, d >>= 2) {
+                p.x |= (d & 1) << bit;
+                p.y |= ((d >> 1) & 1) << bit;
+            }
+            return p;
+        }
+        glm::uvec2 p(0);
+        for (std::uint32_t s = 1; s < n; s *= 2, d /= 4) {
+            std::uint32_t const rx = 1 & (d / 2);
+            std::uint32_t const ry = 1 & (d ^ rx);
+            if (ry == 0) {
+                if (rx == 1) p = glm::uvec2(s - 1) - p;
+                std::swap(p.x, p.y);
+            }
+            p += glm::uvec2(s * rx, s * ry);
+        }
+        return p;
+    }
+
+    // every cell of a width x height grid, in the given order.
+    static std::vector<glm::uvec2> GetTraversal(TraversalOrder const order, std::uint32_t const width, std::uint32_t const height) {
+        std::vector<glm::uvec2> cells;
+        cells.reserve(std::size_t(width) * height);
+        if (order == TraversalOrder::Scanline) {
+            for (std::uint32_t y = 0; y < height; ++y)
+                for (std::uint32_t x = 0; x < width; ++x) cells.emplace_back(x, y);
+            return cells;
+        }
+        std::uint32_t const n = std::bit_ceil(std::max({ width, height, 1u }));
+        for (std::uint32_t d = 0; d < n * n; ++d) {
+            glm::uvec2 const p = GetCurvePoint(order, n, d);
+            if (p.x < width && p.y < height) cells.push_back(p);
+        }
+        return cells;
+    }
+
+    void TileRenderer::Reset() {
+        _tiles.clear();
+        _pixelOrder.clear();
+        _finishedTiles.clear();
+        _finishedPixels = 0;
+        _numPixels      = 0;
+    }
+
+    bool TileRenderer::Render(Common::ImageRGB & image, PixelFunc const & shade, Engine::CancellationToken const & token, ResolveFunc const & resolve) {
+        std::size_t const width  = image.GetSizeX();
+        std::size_t const height = image.GetSizeY();
+        if (_tiles.empty()) {
+            std::uint32_t const size = std::max(Options.TileSize, 1);
+            for (glm::uvec2 const t : GetTraversal(Options.Order, std::uint32_t((width + size - 1) / size), std::uint32_t((height + size - 1) / size))) {
+                std::uint32_t const x = t.x * size;
+                std::uint32_t const y = t.y * size;
+                _tiles.push_back({ x, y, std::min<std::uint32_t>(size, width - x), std::min<std::uint32_t>(size, height - y) });
+            }
+            for (glm::uvec2 const p : GetTraversal(Options.Order, size, size)) _pixelOrder.emplace_back(p);
+            _finishedTiles.assign(_tiles.size(), 0);
+            _finishedPixels = 0;
+            _numPixels      = width * height;
+        }
+
+        // automatic thread counts share the machine-sized pool with every other case.
+        if (Options.NumThreads <= 0) _pool.reset();
+        else if (! _pool || _pool->GetThreadCount() != std::size_t(Options.NumThreads)) {
+            _pool.reset();
+            _pool = std::make_unique<Engine::ThreadPool>(std::size_t(Options.NumThreads));
+        }
+        Engine::ThreadPool & pool = _pool ? *_pool : Common::RenderScheduler::Get().GetPool();
+
+        std::vector<std::size_t> pending;
+        for (std::size_t i = 0; i < _tiles.size(); ++i)
+            if (! _finishedTiles[i]) pending.push_back(i);
+        if (pending.empty()) return true;
+
+        std::latch done(std::ptrdiff_t(pending.size()));
+        for (std::size_t const i : pending) {
+            pool.Submit([&, i]() {
+                Engine::TraceScope     trace("RenderTile", "render");
+                Tile const &           tile = _tiles[i];
+                trace.AddArg("x", tile.X);
+                trace.AddArg("y", tile.Y);
+                std::vector<glm::vec3> colors(std::size_t(tile.Width) * tile.Height);
+                bool                   stopped = false;
+                std::size_t            count   = 0;
+                for (glm::uvec2 const p : _pixelOrder) {
+                    if (p.x >= tile.Width || p.y >= tile.Height) continue;
+                    // as often as once per row.
+                    if (count++ % tile.Width == 0 && (stopped = token.IsCancelled())) break;
+                    colors[std::size_t(p.y) * tile.Width + p.x] = shade(tile.X + p.x, tile.Y + p.y);
+                }
+                if (! stopped) {
+                    if (resolve)
+                        for (std::uint32_t y = 0; y < tile.Height; ++y)
+                            for (std::uint32_t x = 0; x < tile.Width; ++x)
+                                colors[std::size_t(y) * tile.Width + x] = resolve(tile.X + x, tile.Y + y, colors[std::size_t(y) * tile.Width + x]);
+                    {
+                        std::lock_guard lock(_mutex);
+                        for (std::uint32_t y = 0; y < tile.Height; ++y)
+                            for (std::uint32_t x = 0; x < tile.Width; ++x)
+                                image.At(tile.X + x, tile.Y + y) = colors[std::size_t(y) * tile.Width + x];
+                    }
+                    _finishedTiles[i] = 1;
+                    _finishedPixels.fetch_add(colors.size(), std::memory_order_relaxed);
+                    _published = true;
+                }
+                done.count_down();
+            });
+        }
+        done.wait();
+        return IsCompleted();
+    }
+
+} // namespace VCX::Labs::Rendering
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Engine/Async.hpp"
+#include "Engine/ThreadPool.h"
+#include "Labs/Common/ImageRGB.h"
+
+namespace VCX::Labs::Rendering {
+
+    // order in which tiles are handed to the pool and pixels are traced within a tile. along the space-filling
+    // curves consecutive pixels stay close in both directions, so their rays share more BVH nodes and texels.
+    enum class TraversalOrder {
+        Scanline,
+        Morton,
+        Hilbert,
+    };
+
+    struct TileRenderOptions {
+        int            NumThreads { 0 };  // 0 shares the RenderScheduler pool, otherwise a private pool of this size
+        int            TileSize   { 32 }; // in pixels, applies from the next Reset()
+        TraversalOrder Order      { TraversalOrder::Scanline }; // applies from the next Reset()
+    };
+
+    // renders an image as square tiles on a work-stealing thread pool. finished tiles are remembered,
+    // so a stopped render resumes where it left off until Reset() is called.
+    class TileRenderer {
+    public:
+        using PixelFunc   = std::function<glm::vec3(std::size_t const x, std::size_t const y)>;
+        using ResolveFunc = std::function<glm::vec3(std::size_t const x, std::size_t const y, glm::vec3 const & value)>;
+
+        TileRenderOptions Options;
+
+        // forgets every finished tile, only call while no Render(..) is running.
+        void Reset();
+
+        // renders the unfinished tiles into image, blocking until they are done or token is cancelled.
+        // each tile is traced into local storage and copied into image under the lock SyncImage(..) takes.
+        // resolve, when given, maps each shaded value of a finished tile to the displayed one right before it is
+        // published; unlike shade it runs exactly once per pixel, so it may fold the value into an accumulation.
+        // returns whether the whole image is finished.
+        bool Render(Common::ImageRGB & image, PixelFunc const & shade, Engine::CancellationToken const & token, ResolveFunc const & resolve = nullptr);
+
+        // runs upload() under the publishing lock if any tile was published since the last call, so that
+        // the UI thread never reads image while a tile is being copied into it.
+        template<typename Func>
+        void SyncImage(Func && upload) {
+            if (! _published.exchange(false)) return;
+            std::lock_guard lock(_mutex);
+            upload();
+        }
+
+        // makes the next SyncImage(..) upload even if no tile was published since the last one.
+        void Invalidate() { _published = true; }
+
+        // lock-free, safe to call from any thread.
+        std::size_t GetFinishedPixels() const { return _finishedPixels.load(std::memory_order_relaxed); }
+        float       GetProgress() const { return _numPixels ? float(GetFinishedPixels()) / _numPixels : 0.f; }
+        bool        IsCompleted() const { return _numPixels && GetFinishedPixels() == _numPixels; }
+
+    private:
+        struct Tile {
+            std::uint32_t X, Y, Width, Height;
+        };
+
+        std::unique_ptr<Engine::ThreadPool> _pool;       // only with an explicit thread count
+        std::vector<Tile>                   _tiles;      // in traversal order
+        std::vector<glm::uvec2>             _pixelOrder; // offsets within a full tile
+        std::vector<std::uint8_t>           _finishedTiles;
+        std::atomic<std::size_t>            _finishedPixels { 0 };
+        std::atomic<std::size_t>            _numPixels { 0 };
+        std::atomic<bool>                   _published { false };
+        std::mutex                          _mutex;
+    };
+
+} // namespace VCX::Labs::Rendering
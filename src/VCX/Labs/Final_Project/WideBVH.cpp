@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define VCX_WIDE_BVH_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && ! defined(__clang__)
+        #include <intrin.h>
+        #define VCX_TARGET_AVX2
+    #else
+        #define VCX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #endif
+#else
+    #define VCX_WIDE_BVH_X86 0
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "Labs/Final_Project/WideBVH.h"
+
+namespace VCX::Labs::Rendering {
+
+    // the collapsed tree is never deeper than the binary one (64 levels), and each level leaves at most 7 siblings behind.
+    static constexpr std::size_t c_WideStackSize = 7 * 64 + 1;
+
+    namespace {
+        struct WideStackEntry {
+            std::uint32_t Child;
+            std::uint32_t Count;
+            float         TNear;
+        };
+
+        struct WideRay {
+            glm::vec3 Origin;
+            glm::vec3 Direction; // normalized
+            glm::vec3 InvDirection;
+            glm::vec3 OriginInvDirection; // Origin * InvDirection, lets the slab test use a single fma per plane
+            bool      Negative[3];
+        };
+    } // namespace
+
+    static bool DetectAVX2() {
+#if ! VCX_WIDE_BVH_X86
+        return false;
+#elif defined(_MSC_VER) && ! defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        bool const fma     = info[2] & (1 << 12);
+        bool const osxsave = info[2] & (1 << 27);
+        if (! fma || ! osxsave || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return info[1] & (1 << 5);
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+
+    static bool const        s_HasAVX2 = DetectAVX2();
+    static std::atomic<bool> s_UseAVX2 { s_HasAVX2 };
+
+    static WideRay MakeWideRay(Ray const & ray) {
+        WideRay r;
+        r.Origin    = ray.Origin;
+        r.Direction = glm::normalize(ray.Direction);
+        for (int axis = 0; axis < 3; ++axis) {
+            // keep the reciprocal finite, otherwise (bound - origin) * inv turns into inf - inf for axis-parallel rays.
+            float const d        = std::abs(r.Direction[axis]) > 1e-12f ? r.Direction[axis] : std::copysign(1e-12f, r.Direction[axis]);
+            r.InvDirection[axis] = 1.f / d;
+            r.Negative[axis]     = r.InvDirection[axis] < 0;
+        }
+        r.OriginInvDirection = r.Origin * r.InvDirection;
+        return r;
+    }
+
+    // pushes the hit children so that the nearest one is popped first.
+    static void PushSorted(std::array<WideStackEntry, c_WideStackSize> & stack, std::size_t & top, WideStackEntry * hits, int const numHits) {
+        for (int i = 1; i < numHits; ++i) {
+            WideStackEntry const entry = hits[i];
+            int                  j     = i;
+            for (; j > 0 && hits[j - 1].TNear < entry.TNear; --j) hits[j] = hits[j - 1];
+            hits[j] = entry;
+        }
+        for (int i = 0; i < numHits; ++i) stack[top++] = hits[i];
+    }
+
+    // quantizes the children of node conservatively, the decoded bounds always contain the original ones.
+    static bool Quantize(WideBVHNode const & node, QuantizedBVHNode & output) {
+        float const * lo[3] { node.MinX, node.MinY, node.MinZ };
+        float const * hi[3] { node.MaxX, node.MaxY, node.MaxZ };
+        std::uint8_t * qlo[3] { output.LoX, output.LoY, output.LoZ };
+        std::uint8_t * qhi[3] { output.HiX, output.HiY, output.HiZ };
+
+        output.NumChildren = 0;
+        while (output.NumChildren < 8 && node.MinX[output.NumChildren] <= node.MaxX[output.NumChildren]) ++output.NumChildren;
+        for (int i = 0; i < 8; ++i) {
+            output.Child[i] = node.Child[i];
+            output.Count[i] = std::uint16_t(node.Count[i]);
+            if (node.Count[i] > std::numeric_limits<std::uint16_t>::max()) return false;
+        }
+        // both the scalar (mul + add) and the AVX2 (fma) decodings have to be conservative.
+        auto const Contains = [](float const origin, float const scale, int const q, float const value, bool const below) {
+            float const a = origin + float(q) * scale;
+            float const b = std::fma(float(q), scale, origin);
+            return below ? (a <= value && b <= value) : (a >= value && b >= value);
+        };
+        for (int axis = 0; axis < 3; ++axis) {
+            float origin = std::numeric_limits<float>::max(), extent = 0;
+            for (int i = 0; i < output.NumChildren; ++i) origin = std::min(origin, lo[axis][i]);
+            for (int i = 0; i < output.NumChildren; ++i) extent = std::max(extent, hi[axis][i] - origin);
+            // a power of two step keeps q * scale exact, so only the final addition rounds.
+            float scale = extent > 0 ? std::exp2(std::ceil(std::log2(extent / 255.f))) : 1.f;
+            while (true) {
+                bool fits = true;
+                for (int i = 0; i < 8 && fits; ++i) {
+                    if (i >= output.NumChildren) {
+                        qlo[axis][i] = 255;
+                        qhi[axis][i] = 0;
+                        continue;
+                    }
+                    int qmin = std::clamp(int(std::floor((lo[axis][i] - origin) / scale)), 0, 255);
+                    int qmax = std::clamp(int(std::ceil((hi[axis][i] - origin) / scale)), 0, 255);
+                    while (qmin > 0 && ! Contains(origin, scale, qmin, lo[axis][i], true)) --qmin;
+                    while (qmax < 255 && ! Contains(origin, scale, qmax, hi[axis][i], false)) ++qmax;
+                    fits         = Contains(origin, scale, qmin, lo[axis][i], true) && Contains(origin, scale, qmax, hi[axis][i], false);
+                    qlo[axis][i] = std::uint8_t(qmin);
+                    qhi[axis][i] = std::uint8_t(qmax);
+                }
+                if (fits) break;
+                scale *= 2;
+            }
+            output.Origin[axis] = origin;
+            output.Scale[axis]  = scale;
+        }
+        return true;
+    }
+
+    void WideBVH::Build(std::vector<BVHNode> const & nodes, std::vector<AccelTriangle> const & triangles, bool const quantized) {
+        Clear();
+        if (nodes.empty()) return;
+        // a triangle block costs the same to test as a single triangle, so subtrees with at most 8 triangles become
+        // single leaves. children come after their parents and leaves are in triangle order, so one backward pass merges them.
+        std::vector<BVHNode> merged = nodes;
+        for (std::size_t i = merged.size(); i-- > 0;) {
+            if (merged[i].Count > 0) continue;
+            BVHNode const & left  = merged[i + 1];
+            BVHNode const & right = merged[merged[i].Offset];
+            if (left.Count > 0 && right.Count > 0 && left.Count + right.Count <= 8)
+                merged[i] = { merged[i].Bounds, left.Offset, left.Count + right.Count };
+        }
+        _nodes.reserve(nodes.size() / 4 + 1);
+        _blocks.reserve(triangles.size() / 8 + 1);
+        CollapseRecursive(merged, triangles, 0, 0);
+        _nodes.shrink_to_fit();
+        _blocks.shrink_to_fit();
+        if (! quantized) return;
+
+        std::vector<QuantizedBVHNode> quantizedNodes(_nodes.size());
+        for (std::size_t i = 0; i < _nodes.size(); ++i) {
+            if (! Quantize(_nodes[i], quantizedNodes[i])) {
+                spdlog::warn("VCX::Labs::Rendering::WideBVH::Build(..): leaf too large to quantize, keeping full precision nodes.");
+                return;
+            }
+        }
+        _quantizedNodes = std::move(quantizedNodes);
+        std::vector<WideBVHNode>().swap(_nodes);
+    }
+
+    void WideBVH::Clear() {
+        _nodes.clear();
+        _quantizedNodes.clear();
+        _blocks.clear();
+        _depth = 0;
+    }
+
+    void WideBVH::Write(std::ostream & out) const {
+        WriteRaw(out, std::uint64_t(_depth));
+        WriteArray(out, _nodes);
+        WriteArray(out, _quantizedNodes);
+        WriteArray(out, _blocks);
+    }
+
+    bool WideBVH::Read(std::istream & in) {
+        Clear();
+        std::uint64_t depth;
+        if (ReadRaw(in, depth) && ReadArray(in, _nodes) && ReadArray(in, _quantizedNodes) && ReadArray(in, _blocks)) {
+            _depth = std::size_t(depth);
+            return true;
+        }
+        Clear();
+        return false;
+    }
+
+    std::uint32_t WideBVH::CollapseRecursive(std::vector<BVHNode> const & nodes, std::vector<AccelTriangle> const & triangles, std::uint32_t const root, std::size_t const depth) {
+        auto const nodeIdx = std::uint32_t(_nodes.size());
+        _nodes.emplace_back();
+        _depth = std::max(_depth, depth + 1);
+
+        // repeatedly open the interior child with the largest surface area until all 8 slots are used.
+        std::array<std::uint32_t, 8> children;
+        int                          numChildren = 1;
+        children[0]                              = root;
+        while (numChildren < 8) {
+            int   best     = -1;
+            float bestArea = -1;
+            for (int i = 0; i < numChildren; ++i) {
+                BVHNode const & child = nodes[children[i]];
+                if (child.Count == 0 && child.Bounds.GetSurfaceArea() > bestArea) {
+                    best     = i;
+                    bestArea = child.Bounds.GetSurfaceArea();
+                }
+            }
+            if (best < 0) break;
+            std::uint32_t const opened = children[best];
+            children[best]             = opened + 1;
+            children[numChildren++]    = nodes[opened].Offset;
+        }
+
+        float const inf = std::numeric_limits<float>::infinity();
+        for (int i = 0; i < 8; ++i) {
+            AABB          bounds { glm::vec3(inf), glm::vec3(-inf) };
+            std::uint32_t ref   = 0;
+            std::uint32_t count = 0;
+            if (i < numChildren) {
+                BVHNode const & child = nodes[children[i]];
+                bounds                = child.Bounds;
+                if (child.Count > 0) {
+                    ref   = std::uint32_t(_blocks.size());
+                    count = (child.Count + 7) / 8;
+                    for (std::uint32_t k = 0; k < child.Count; ++k) {
+                        if (k % 8 == 0) _blocks.emplace_back();
+                        WideTriangleBlock &   block = _blocks.back();
+                        AccelTriangle const & tri   = triangles[child.Offset + k];
+                        glm::vec3 const       e1    = tri.P2 - tri.P1;
+                        glm::vec3 const       e2    = tri.P3 - tri.P1;
+                        std::uint32_t const   lane  = k % 8;
+                        block.V0X[lane]             = tri.P1.x;
+                        block.V0Y[lane]             = tri.P1.y;
+                        block.V0Z[lane]             = tri.P1.z;
+                        block.E1X[lane]             = e1.x;
+                        block.E1Y[lane]             = e1.y;
+                        block.E1Z[lane]             = e1.z;
+                        block.E2X[lane]             = e2.x;
+                        block.E2Y[lane]             = e2.y;
+                        block.E2Z[lane]             = e2.z;
+                        block.FaceIndex[lane]       = tri.FaceIndex;
+                    }
+                } else {
+                    ref = CollapseRecursive(nodes, triangles, children[i], depth + 1);
+                }
+            }
+            WideBVHNode & node = _nodes[nodeIdx]; // the recursion may have reallocated _nodes
+            node.MinX[i]       = bounds.Min.x;
+            node.MinY[i]       = bounds.Min.y;
+            node.MinZ[i]       = bounds.Min.z;
+            node.MaxX[i]       = bounds.Max.x;
+            node.MaxY[i]       = bounds.Max.y;
+            node.MaxZ[i]       = bounds.Max.z;
+            node.Child[i]      = ref;
+            node.Count[i]      = count;
+        }
+        return nodeIdx;
+    }
+
+    bool WideBVH::IsAVX2Supported() {
+        return s_HasAVX2;
+    }
+
+    bool WideBVH::IsAVX2Enabled() {
+        return s_UseAVX2.load(std::memory_order_relaxed);
+    }
+
+    void WideBVH::SetAVX2Enabled(bool const enabled) {
+        s_UseAVX2.store(enabled && s_HasAVX2, std::memory_order_relaxed);
+    }
+
+    bool WideBVH::Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const {
+        if (IsEmpty()) return false;
+        return IsAVX2Enabled() ? IntersectAVX2(ray, tMin, tMax, hit) : IntersectScalar(ray, tMin, tMax, hit);
+    }
+
+    bool WideBVH::Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter) const {
+        if (IsEmpty()) return false;
+        AccelHit hit;
+        return IsAVX2Enabled() ? IntersectAVX2(ray, tMin, tMax, hit, &filter) : IntersectScalar(ray, tMin, tMax, hit, &filter);
+    }
+
+    // the same Moller-Trumbore test as IntersectTriangle, lane by lane.
+    // with anyHit, returns at the first lane the filter accepts and leaves tBest alone.
+    static bool IntersectBlockScalar(WideTriangleBlock const & block, WideRay const & r, float const tMin, float & tBest, AccelHit & hit, AnyHitFilter const * anyHit) {
+        bool found = false;
+        for (int k = 0; k < 8; ++k) {
+            glm::vec3 const e1 { block.E1X[k], block.E1Y[k], block.E1Z[k] };
+            glm::vec3 const e2 { block.E2X[k], block.E2Y[k], block.E2Z[k] };
+            glm::vec3 const p  = glm::cross(r.Direction, e2);
+            float const     det = glm::dot(e1, p);
+            if (det < 1e-4f) continue;
+            float const     invDet = 1.f / det;
+            glm::vec3 const s      = r.Origin - glm::vec3(block.V0X[k], block.V0Y[k], block.V0Z[k]);
+            float const     u      = glm::dot(s, p) * invDet;
+            if (u <= 0 || u >= 1) continue;
+            glm::vec3 const q = glm::cross(s, e1);
+            float const     v = glm::dot(r.Direction, q) * invDet;
+            if (v <= 0 || v >= 1 || u + v >= 1) continue;
+            float const t = glm::dot(e2, q) * invDet;
+            if (t < tMin || t > tBest) continue;
+            if (anyHit) {
+                if ((*anyHit)({ t, u, v, 0, block.FaceIndex[k] })) return true;
+                continue;
+            }
+            tBest         = t;
+            hit.T         = t;
+            hit.U         = u;
+            hit.V         = v;
+            hit.FaceIndex = block.FaceIndex[k];
+            found         = true;
+        }
+        return found;
+    }
+
+    static int GetChildCount(WideBVHNode const &) { return 8; } // unused slots have empty bounds
+    static int GetChildCount(QuantizedBVHNode const & node) { return node.NumChildren; }
+
+    static void GetChildBounds(WideBVHNode const & node, int const i, glm::vec3 & lo, glm::vec3 & hi) {
+        lo = { node.MinX[i], node.MinY[i], node.MinZ[i] };
+        hi = { node.MaxX[i], node.MaxY[i], node.MaxZ[i] };
+    }
+
+    static void GetChildBounds(QuantizedBVHNode const & node, int const i, glm::vec3 & lo, glm::vec3 & hi) {
+        glm::vec3 const origin { node.Origin[0], node.Origin[1], node.Origin[2] };
+        glm::vec3 const scale { node.Scale[0], node.Scale[1], node.Scale[2] };
+        lo = origin + glm::vec3(node.LoX[i], node.LoY[i], node.LoZ[i]) * scale;
+        hi = origin + glm::vec3(node.HiX[i], node.HiY[i], node.HiZ[i]) * scale;
+    }
+
+    // closest hit, or any hit accepted by anyHit when it is not null.
+    template<typename Node>
+    static bool TraverseScalar(std::vector<Node> const & nodes, std::vector<WideTriangleBlock> const & blocks, WideRay const & r, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit) {
+        float                                       tBest = tMax;
+        bool                                        found = false;
+        std::array<WideStackEntry, c_WideStackSize> stack;
+        std::size_t                                 top = 0;
+        stack[top++]                                    = { 0, 0, tMin };
+        TraversalTally                              tally;
+        while (top > 0) {
+            WideStackEntry const entry = stack[--top];
+            if (entry.TNear > tBest) continue;
+            ++tally.Nodes;
+            if (entry.Count > 0) {
+                for (std::uint32_t b = entry.Child; b < entry.Child + entry.Count; ++b) {
+                    tally.Triangles += 8;
+                    if (! IntersectBlockScalar(blocks[b], r, tMin, tBest, hit, anyHit)) continue;
+                    if (anyHit) return true;
+                    found = true;
+                }
+                continue;
+            }
+            Node const &   node = nodes[entry.Child];
+            WideStackEntry hits[8];
+            int            numHits = 0;
+            for (int i = 0; i < GetChildCount(node); ++i) {
+                glm::vec3 lo, hi;
+                GetChildBounds(node, i, lo, hi);
+                float tNear = tMin, tFar = tBest;
+                for (int axis = 0; axis < 3; ++axis) {
+                    float const nearPlane = r.Negative[axis] ? hi[axis] : lo[axis];
+                    float const farPlane  = r.Negative[axis] ? lo[axis] : hi[axis];
+                    tNear                 = std::max(tNear, nearPlane * r.InvDirection[axis] - r.OriginInvDirection[axis]);
+                    tFar                  = std::min(tFar, farPlane * r.InvDirection[axis] - r.OriginInvDirection[axis]);
+                }
+                if (tNear <= tFar) hits[numHits++] = { node.Child[i], node.Count[i], tNear };
+            }
+            PushSorted(stack, top, hits, numHits);
+        }
+        return found;
+    }
+
+    bool WideBVH::IntersectScalar(Ray const & ray, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit) const {
+        WideRay const r = MakeWideRay(ray);
+        return _quantizedNodes.empty()
+            ? TraverseScalar(_nodes, _blocks, r, tMin, tMax, hit, anyHit)
+            : TraverseScalar(_quantizedNodes, _blocks, r, tMin, tMax, hit, anyHit);
+    }
+
+#if VCX_WIDE_BVH_X86
+    namespace {
+        struct WideRayAVX2 {
+            __m256 InvX, InvY, InvZ;
+            __m256 OriginInvX, OriginInvY, OriginInvZ;
+            __m256 TMin;
+        };
+    } // namespace
+
+    VCX_TARGET_AVX2 static bool IntersectBlockAVX2(WideTriangleBlock const & block, WideRay const & r, float const tMin, float & tBest, AccelHit & hit, AnyHitFilter const * anyHit) {
+        __m256 const dx  = _mm256_set1_ps(r.Direction.x);
+        __m256 const dy  = _mm256_set1_ps(r.Direction.y);
+        __m256 const dz  = _mm256_set1_ps(r.Direction.z);
+        __m256 const e1x = _mm256_load_ps(block.E1X);
+        __m256 const e1y = _mm256_load_ps(block.E1Y);
+        __m256 const e1z = _mm256_load_ps(block.E1Z);
+        __m256 const e2x = _mm256_load_ps(block.E2X);
+        __m256 const e2y = _mm256_load_ps(block.E2Y);
+        __m256 const e2z = _mm256_load_ps(block.E2Z);
+
+        // p = d x e2, det = e1 . p
+        __m256 const px  = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+        __m256 const py  = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+        __m256 const pz  = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+        __m256 const det = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+
+        // s = o - v0, u = (s . p) / det
+        __m256 const sx     = _mm256_sub_ps(_mm256_set1_ps(r.Origin.x), _mm256_load_ps(block.V0X));
+        __m256 const sy     = _mm256_sub_ps(_mm256_set1_ps(r.Origin.y), _mm256_load_ps(block.V0Y));
+        __m256 const sz     = _mm256_sub_ps(_mm256_set1_ps(r.Origin.z), _mm256_load_ps(block.V0Z));
+        __m256 const invDet = _mm256_div_ps(_mm256_set1_ps(1.f), det);
+        __m256 const u      = _mm256_mul_ps(_mm256_fmadd_ps(sx, px, _mm256_fmadd_ps(sy, py, _mm256_mul_ps(sz, pz))), invDet);
+
+        // q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+        __m256 const qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+        __m256 const qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+        __m256 const qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+        __m256 const v  = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), invDet);
+        __m256 const t  = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), invDet);
+
+        __m256 const zero = _mm256_setzero_ps();
+        __m256 const one  = _mm256_set1_ps(1.f);
+        __m256       mask = _mm256_cmp_ps(det, _mm256_set1_ps(1e-4f), _CMP_GE_OQ);
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GT_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(u, one, _CMP_LT_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GT_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(v, one, _CMP_LT_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LT_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GE_OQ));
+        mask              = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(tBest), _CMP_LE_OQ));
+        unsigned bits     = unsigned(_mm256_movemask_ps(mask));
+        if (bits == 0) return false;
+
+        alignas(32) float ts[8], us[8], vs[8];
+        _mm256_store_ps(ts, t);
+        _mm256_store_ps(us, u);
+        _mm256_store_ps(vs, v);
+        if (anyHit) {
+            for (; bits != 0; bits &= bits - 1) {
+                int const k = std::countr_zero(bits);
+                if ((*anyHit)({ ts[k], us[k], vs[k], 0, block.FaceIndex[k] })) return true;
+            }
+            return false;
+        }
+        int best = -1;
+        for (; bits != 0; bits &= bits - 1) {
+            int const k = std::countr_zero(bits);
+            if (best < 0 || ts[k] < ts[best]) best = k;
+        }
+        tBest         = ts[best];
+        hit.T         = ts[best];
+        hit.U         = us[best];
+        hit.V         = vs[best];
+        hit.FaceIndex = block.FaceIndex[best];
+        return true;
+    }
+
+    // slab test against all children, returns the hit mask and stores the entry distances.
+    VCX_TARGET_AVX2 static unsigned IntersectChildrenAVX2(__m256 const (&bounds)[6], WideRay const & r, WideRayAVX2 const & rv, float const tBest, float * tNears) {
+        __m256 const nearX = _mm256_fmsub_ps(bounds[r.Negative[0] ? 3 : 0], rv.InvX, rv.OriginInvX);
+        __m256 const nearY = _mm256_fmsub_ps(bounds[r.Negative[1] ? 4 : 1], rv.InvY, rv.OriginInvY);
+        __m256 const nearZ = _mm256_fmsub_ps(bounds[r.Negative[2] ? 5 : 2], rv.InvZ, rv.OriginInvZ);
+        __m256 const farX  = _mm256_fmsub_ps(bounds[r.Negative[0] ? 0 : 3], rv.InvX, rv.OriginInvX);
+        __m256 const farY  = _mm256_fmsub_ps(bounds[r.Negative[1] ? 1 : 4], rv.InvY, rv.OriginInvY);
+        __m256 const farZ  = _mm256_fmsub_ps(bounds[r.Negative[2] ? 2 : 5], rv.InvZ, rv.OriginInvZ);
+        __m256 const tNear = _mm256_max_ps(_mm256_max_ps(nearX, nearY), _mm256_max_ps(nearZ, rv.TMin));
+        __m256 const tFar  = _mm256_min_ps(_mm256_min_ps(farX, farY), _mm256_min_ps(farZ, _mm256_set1_ps(tBest)));
+        _mm256_store_ps(tNears, tNear);
+        return unsigned(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+    }
+
+    VCX_TARGET_AVX2 static unsigned IntersectChildrenAVX2(WideBVHNode const & node, WideRay const & r, WideRayAVX2 const & rv, float const tBest, float * tNears) {
+        __m256 const bounds[6] {
+            _mm256_load_ps(node.MinX), _mm256_load_ps(node.MinY), _mm256_load_ps(node.MinZ),
+            _mm256_load_ps(node.MaxX), _mm256_load_ps(node.MaxY), _mm256_load_ps(node.MaxZ),
+        };
+        return IntersectChildrenAVX2(bounds, r, rv, tBest, tNears);
+    }
+
+    VCX_TARGET_AVX2 static __m256 DecodeAVX2(std::uint8_t const * q, float const scale, float const origin) {
+        __m256 const values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(q))));
+        return _mm256_fmadd_ps(values, _mm256_set1_ps(scale), _mm256_set1_ps(origin));
+    }
+
+    VCX_TARGET_AVX2 static unsigned IntersectChildrenAVX2(QuantizedBVHNode const & node, WideRay const & r, WideRayAVX2 const & rv, float const tBest, float * tNears) {
+        __m256 const bounds[6] {
+            DecodeAVX2(node.LoX, node.Scale[0], node.Origin[0]), DecodeAVX2(node.LoY, node.Scale[1], node.Origin[1]), DecodeAVX2(node.LoZ, node.Scale[2], node.Origin[2]),
+            DecodeAVX2(node.HiX, node.Scale[0], node.Origin[0]), DecodeAVX2(node.HiY, node.Scale[1], node.Origin[1]), DecodeAVX2(node.HiZ, node.Scale[2], node.Origin[2]),
+        };
+        return IntersectChildrenAVX2(bounds, r, rv, tBest, tNears) & ((1u << node.NumChildren) - 1);
+    }
+
+    template<typename Node>
+    VCX_TARGET_AVX2 static bool TraverseAVX2(std::vector<Node> const & nodes, std::vector<WideTriangleBlock> const & blocks, WideRay const & r, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit) {
+        WideRayAVX2 const rv {
+            .InvX       = _mm256_set1_ps(r.InvDirection.x),
+            .InvY       = _mm256_set1_ps(r.InvDirection.y),
+            .InvZ       = _mm256_set1_ps(r.InvDirection.z),
+            .OriginInvX = _mm256_set1_ps(r.OriginInvDirection.x),
+            .OriginInvY = _mm256_set1_ps(r.OriginInvDirection.y),
+            .OriginInvZ = _mm256_set1_ps(r.OriginInvDirection.z),
+            .TMin       = _mm256_set1_ps(tMin),
+        };
+        float tBest = tMax;
+        bool  found = false;
+
+        std::array<WideStackEntry, c_WideStackSize> stack;
+        std::size_t                                 top = 0;
+        stack[top++]                                    = { 0, 0, tMin };
+        TraversalTally                              tally;
+        while (top > 0) {
+            WideStackEntry const entry = stack[--top];
+            if (entry.TNear > tBest) continue;
+            ++tally.Nodes;
+            if (entry.Count > 0) {
+                for (std::uint32_t b = entry.Child; b < entry.Child + entry.Count; ++b) {
+                    tally.Triangles += 8;
+                    if (! IntersectBlockAVX2(blocks[b], r, tMin, tBest, hit, anyHit)) continue;
+                    if (anyHit) return true;
+                    found = true;
+                }
+                continue;
+            }
+            Node const &      node = nodes[entry.Child];
+            alignas(32) float tNears[8];
+            unsigned          bits = IntersectChildrenAVX2(node, r, rv, tBest, tNears);
+            if (bits == 0) continue;
+
+            WideStackEntry hits[8];
+            int            numHits = 0;
+            for (; bits != 0; bits &= bits - 1) {
+                int const i      = std::countr_zero(bits);
+                hits[numHits++] = { node.Child[i], node.Count[i], tNears[i] };
+            }
+            PushSorted(stack, top, hits, numHits);
+        }
+        return found;
+    }
+
+    VCX_TARGET_AVX2 bool WideBVH::IntersectAVX2(Ray const & ray, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit) const {
+        WideRay const r = MakeWideRay(ray);
+        return _quantizedNodes.empty()
+            ? TraverseAVX2(_nodes, _blocks, r, tMin, tMax, hit, anyHit)
+            : TraverseAVX2(_quantizedNodes, _blocks, r, tMin, tMax, hit, anyHit);
+    }
+#else
+    bool WideBVH::IntersectAVX2(Ray const & ray, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit) const {
+        return IntersectScalar(ray, tMin, tMax, hit, anyHit);
+    }
+#endif
+
+} // namespace VCX::Labs::Rendering
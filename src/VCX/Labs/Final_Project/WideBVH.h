@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Labs/Final_Project/Accel.h"
+#include "Labs/Final_Project/Ray.h"
+
+namespace VCX::Labs::Rendering {
+
+    // child bounds are stored as structure of arrays so that all 8 slabs are tested at once.
+    struct alignas(32) WideBVHNode {
+        float         MinX[8], MinY[8], MinZ[8];
+        float         MaxX[8], MaxY[8], MaxZ[8];
+        std::uint32_t Child[8]; // interior: node index; leaf: first triangle block
+        std::uint32_t Count[8]; // 0 for interior children, number of triangle blocks for leaves; unused slots have empty bounds
+    };
+
+    // WideBVHNode with the child bounds quantized to 8 bits on a power-of-two grid inside the node bounds, half the size.
+    struct alignas(16) QuantizedBVHNode {
+        float         Origin[3];
+        float         Scale[3];
+        std::uint8_t  LoX[8], LoY[8], LoZ[8];
+        std::uint8_t  HiX[8], HiY[8], HiZ[8];
+        std::uint32_t Child[8];
+        std::uint16_t Count[8];
+        std::uint8_t  NumChildren; // children occupy the first slots
+    };
+
+    // 8 triangles prepared for Moller-Trumbore, unused lanes are degenerate and never hit.
+    struct alignas(32) WideTriangleBlock {
+        float         V0X[8], V0Y[8], V0Z[8];
+        float         E1X[8], E1Y[8], E1Z[8]; // V1 - V0
+        float         E2X[8], E2Y[8], E2Z[8]; // V2 - V0
+        std::uint32_t FaceIndex[8];
+    };
+
+    // 8-wide layout collapsed from a binary BVH, traversed with AVX2 when the CPU supports it.
+    class WideBVH {
+    public:
+        // nodes and triangles are a binary hierarchy in leaf order as produced by BVH::Build.
+        void Build(std::vector<BVHNode> const & nodes, std::vector<AccelTriangle> const & triangles, bool const quantized = false);
+        void Clear();
+
+        void Write(std::ostream & out) const;
+        bool Read(std::istream & in);
+
+        bool        IsEmpty() const { return _nodes.empty() && _quantizedNodes.empty(); }
+        std::size_t GetNodeCount() const { return _nodes.size() + _quantizedNodes.size(); }
+        std::size_t GetNodeBytes() const { return _nodes.size() * sizeof(WideBVHNode) + _quantizedNodes.size() * sizeof(QuantizedBVHNode); }
+        std::size_t GetTriangleBytes() const { return _blocks.size() * sizeof(WideTriangleBlock); }
+        std::size_t GetDepth() const { return _depth; }
+
+        // same contract as BVH::Intersect.
+        bool Intersect(Ray const & ray, float const tMin, float const tMax, AccelHit & hit) const;
+
+        // same contract as BVH::Occluded.
+        bool Occluded(Ray const & ray, float const tMin, float const tMax, AnyHitFilter const & filter = { }) const;
+
+        // Intersect runs the AVX2 kernels when the CPU supports them, unless they are switched off for comparison.
+        static bool IsAVX2Supported();
+        static bool IsAVX2Enabled();
+        static void SetAVX2Enabled(bool const enabled);
+
+    private:
+        std::uint32_t CollapseRecursive(std::vector<BVHNode> const & nodes, std::vector<AccelTriangle> const & triangles, std::uint32_t const root, std::size_t const depth);
+
+        // a non-null anyHit turns the closest-hit query into an occlusion query.
+        bool IntersectScalar(Ray const & ray, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit = nullptr) const;
+        bool IntersectAVX2(Ray const & ray, float const tMin, float const tMax, AccelHit & hit, AnyHitFilter const * anyHit = nullptr) const;
+
+        std::vector<WideBVHNode>       _nodes;          // empty when quantized
+        std::vector<QuantizedBVHNode>  _quantizedNodes; // empty unless quantized
+        std::vector<WideTriangleBlock> _blocks;
+        std::size_t                    _depth { 0 };
+    };
+
+} // namespace VCX::Labs::Rendering
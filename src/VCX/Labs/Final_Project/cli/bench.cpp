@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+#include "Assets/bundled.h"
+#include "Engine/loader.h"
+#include "Labs/Final_Project/Benchmark.h"
+#include "Labs/Final_Project/Sampler.h"
+#include "Labs/Final_Project/tasks.h"
+
+// microbenchmarks of the kernels in tasks.cpp, single-threaded on fixed inputs so that two runs on the same
+// machine are comparable. every kernel is timed over a calibrated number of operations a few times and the
+// median is reported; with --baseline the results are compared with the JSON of an earlier run. --layouts
+// instead compares the BVH layouts on the selected scenes, see BenchmarkBVHLayouts(..).
+
+namespace VCX::Labs::Rendering {
+
+    struct BenchArgs {
+        std::string                          Filter;             // substring of the kernel names to run, empty for all
+        std::vector<std::string>             Scenes;             // bundled scene names, empty for all that exist
+        std::uint32_t                        Resolution { 128 }; // of the camera rays and pixels
+        double                               MinTime { .05 };    // per repetition, in seconds
+        int                                  Repetitions { 5 };
+        std::optional<std::filesystem::path> Output;             // JSON
+        std::optional<std::filesystem::path> Baseline;           // JSON of an earlier run
+        double                               Threshold { 5 };    // in percent, slower than this is a regression
+        bool                                 Layouts { false };  // runs BenchmarkBVHLayouts(..) instead of the kernels
+        bool                                 Help { false };     // usage was printed for --help, nothing to run
+    };
+
+    static constexpr char const * c_Usage =
+        "usage: render-bench [options]\n"
+        "  -f, --filter <text>      only kernels whose name contains text\n"
+        "      --scenes <a,b,..>    bundled scenes by name, e.g. cornell_box (all)\n"
+        "  -r, --resolution <n>     camera rays and pixels per side (128)\n"
+        "      --min-time <s>       seconds per repetition (0.05)\n"
+        "      --repetitions <n>    timed repetitions, the median is reported (5)\n"
+        "  -o, --json <file>        writes the results as JSON\n"
+        "  -b, --baseline <file>    compares with the JSON of an earlier run, exits with 1 on a regression\n"
+        "      --threshold <pct>    slowdown counted as a regression (5)\n"
+        "      --layouts            compares the BVH layouts on the scenes instead, e.g. --scenes sponza,white_oak\n";
+
+    // the optimizer has to keep every value a kernel folds into it.
+    static volatile float g_Sink;
+
+    struct Kernel {
+        std::string Name;
+        // runs numOps operations, cycling through the inputs of the kernel, and returns a value to sink.
+        std::function<float(std::size_t const numOps)> Run;
+        // rays per operation; with Intersector set, the rays it counted are used instead.
+        double                 RaysPerOp { 0 };
+        RayIntersector const * Intersector { nullptr };
+    };
+
+    struct BenchResult {
+        std::string Name;
+        double      NsPerOp;     // median over the repetitions
+        double      MinNsPerOp;
+        double      MRaysPerSec; // 0 for kernels that trace no rays
+        std::size_t NumOps;      // per repetition
+    };
+
+    static std::vector<std::string> SplitList(std::string const & text) {
+        std::vector<std::string> items;
+        std::size_t              begin = 0;
+        while (begin <= text.size()) {
+            std::size_t const end = std::min(text.find(',', begin), text.size());
+            if (end > begin) items.emplace_back(text.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return items;
+    }
+
+    // returns nullopt after reporting the first malformed argument, and arguments with Help set after printing the usage.
+    static std::optional<BenchArgs> ParseArgs(int argc, char ** argv) {
+        BenchArgs args;
+        for (int k = 1; k < argc; ++k) {
+            std::string_view const arg  = argv[k];
+            std::string const      next = k + 1 < argc ? argv[k + 1] : "";
+            auto const             Fail = [&](char const * reason) -> std::optional<BenchArgs> {
+                spdlog::error("VCX::Labs::Rendering::ParseArgs(..): {} for \"{}\".", reason, arg);
+                return std::nullopt;
+            };
+            bool const hasNext = k + 1 < argc;
+            if (arg == "--help") {
+                std::fputs(c_Usage, stdout);
+                args.Help = true;
+                return args;
+            } else if (arg == "-f" || arg == "--filter") {
+                if (! hasNext) return Fail("missing text");
+                args.Filter = next, ++k;
+            } else if (arg == "--scenes") {
+                if (! hasNext) return Fail("missing scene names");
+                args.Scenes = SplitList(next), ++k;
+            } else if (arg == "-r" || arg == "--resolution") {
+                if (! hasNext || (args.Resolution = std::uint32_t(std::atoi(next.c_str()))) == 0) return Fail("expected a positive size");
+                ++k;
+            } else if (arg == "--min-time") {
+                if (! hasNext || (args.MinTime = std::atof(next.c_str())) <= 0) return Fail("expected seconds");
+                ++k;
+            } else if (arg == "--repetitions") {
+                if (! hasNext || (args.Repetitions = std::atoi(next.c_str())) < 1) return Fail("expected a positive count");
+                ++k;
+            } else if (arg == "-o" || arg == "--json") {
+                if (! hasNext) return Fail("missing file name");
+                args.Output = next, ++k;
+            } else if (arg == "-b" || arg == "--baseline") {
+                if (! hasNext) return Fail("missing file name");
+                args.Baseline = next, ++k;
+            } else if (arg == "--threshold") {
+                if (! hasNext || (args.Threshold = std::atof(next.c_str())) < 0) return Fail("expected a percentage");
+                ++k;
+            } else if (arg == "--layouts") {
+                args.Layouts = true;
+            } else return Fail("unexpected argument");
+        }
+        return args;
+    }
+
+    static glm::vec3 RandomDirection(PCG32 & rng) {
+        float const z   = 1 - 2 * rng.NextFloat();
+        float const r   = std::sqrt(std::max(0.f, 1 - z * z));
+        float const phi = 6.2831853f * rng.NextFloat();
+        return { r * std::cos(phi), r * std::sin(phi), z };
+    }
+
+    // the ray through the center of pixel (i, j) of a square image, as the renderers generate it.
+    static Ray GetCameraRay(Engine::Camera const & camera, std::uint32_t const resolution, float const i, float const j) {
+        glm::vec3 const lookDir   = glm::normalize(camera.Target - camera.Eye);
+        glm::vec3 const rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+        glm::vec3 const upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+        float const     fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+        glm::vec3       dir       = lookDir;
+        dir += fovFactor * (2.0f * j / resolution - 1.0f) * upDir;
+        dir += fovFactor * (2.0f * i / resolution - 1.0f) * rightDir;
+        return Ray(camera.Eye, glm::normalize(dir));
+    }
+
+    static void AddTriangleKernel(std::vector<Kernel> & kernels) {
+        // rays from around the origin towards triangles of random size near it, about half of them hit.
+        struct Input {
+            Ray       Incident;
+            glm::vec3 P1, P2, P3;
+        };
+        auto  inputs = std::make_shared<std::vector<Input>>(4096);
+        PCG32 rng(1);
+        for (auto & input : *inputs) {
+            glm::vec3 const center = 2.f * RandomDirection(rng);
+            float const     size   = .5f + rng.NextFloat();
+            input.P1               = center + size * RandomDirection(rng);
+            input.P2               = center + size * RandomDirection(rng);
+            input.P3               = center + size * RandomDirection(rng);
+            input.Incident         = Ray(.1f * RandomDirection(rng), glm::normalize(center + .5f * RandomDirection(rng)));
+        }
+        kernels.push_back({ "IntersectTriangle", [inputs](std::size_t const numOps) {
+                               float sum = 0;
+                               for (std::size_t k = 0; k < numOps; ++k) {
+                                   auto const & input = (*inputs)[k & 4095];
+                                   Intersection its;
+                                   if (IntersectTriangle(its, input.Incident, input.P1, input.P2, input.P3)) sum += its.t;
+                               }
+                               return sum;
+                           },
+                            1 });
+    }
+
+    static void AddTextureKernels(std::vector<Kernel> & kernels) {
+        // a 512x512 texture of random texels and random coordinates, mostly in [0, 1) but some wrapping around.
+        auto  material = std::make_shared<Engine::Material>();
+        PCG32 rng(2);
+        material->Albedo = Engine::Texture2D<Engine::Formats::RGBA8>(512, 512);
+        for (std::size_t y = 0; y < 512; ++y)
+            for (std::size_t x = 0; x < 512; ++x)
+                material->Albedo.At(x, y) = glm::vec4(rng.NextFloat(), rng.NextFloat(), rng.NextFloat(), 1);
+        auto uvs = std::make_shared<std::vector<glm::vec2>>(4096);
+        for (auto & uv : *uvs) uv = glm::vec2(rng.NextFloat(), rng.NextFloat()) * 1.25f - .125f;
+
+        kernels.push_back({ "GetTexture", [material, uvs](std::size_t const numOps) {
+                               float sum = 0;
+                               for (std::size_t k = 0; k < numOps; ++k) sum += GetTexture(material->Albedo, (*uvs)[k & 4095]).x;
+                               return sum;
+                           } });
+        kernels.push_back({ "GetAlbedo", [material, uvs](std::size_t const numOps) {
+                               float sum = 0;
+                               for (std::size_t k = 0; k < numOps; ++k) sum += GetAlbedo(*material, (*uvs)[k & 4095]).x;
+                               return sum;
+                           } });
+    }
+
+    static void AddHaltonKernels(std::vector<Kernel> & kernels) {
+        // the two bases of the Whitted jitter, and a prime beyond the tabulated ones for the fallback loop.
+        for (int const base : { 2, 3, 331 }) {
+            kernels.push_back({ fmt::format("halton/base{}", base), [base](std::size_t const numOps) {
+                                   float sum = 0;
+                                   for (std::size_t k = 0; k < numOps; ++k) sum += halton(int(k & 0xfffff), base);
+                                   return sum;
+                               } });
+        }
+    }
+
+    struct SceneBench {
+        std::string      Name;
+        Engine::Scene    Scene;
+        RayIntersector   Intersector;
+        std::vector<Ray> PrimaryRays;
+        std::vector<Ray> SecondaryRays; // uniformly distributed directions from the primary hits
+    };
+
+    static void AddSceneKernels(std::vector<Kernel> & kernels, std::shared_ptr<SceneBench> const & bench, std::uint32_t const resolution) {
+        auto const & camera = bench->Scene.Cameras[0];
+        for (std::uint32_t j = 0; j < resolution; ++j)
+            for (std::uint32_t i = 0; i < resolution; ++i)
+                bench->PrimaryRays.push_back(GetCameraRay(camera, resolution, i + .5f, j + .5f));
+        PCG32 rng(3);
+        for (auto const & ray : bench->PrimaryRays) {
+            AccelHit hit;
+            if (! bench->Intersector.Intersect(ray, hit)) continue;
+            bench->SecondaryRays.emplace_back(ray.Origin + hit.T * ray.Direction, RandomDirection(rng));
+        }
+
+        auto const AddRays = [&](char const * kind, std::vector<Ray> const & rays, RayType const type) {
+            if (rays.empty()) return;
+            kernels.push_back({ fmt::format("IntersectRay/{}/{}", bench->Name, kind), [bench, &rays, type](std::size_t const numOps) {
+                                   float sum = 0;
+                                   for (std::size_t k = 0; k < numOps; ++k) {
+                                       RayHit const hit = bench->Intersector.IntersectRay(rays[k % rays.size()], type);
+                                       if (hit.IntersectState) sum += hit.IntersectAlbedo.x;
+                                   }
+                                   return sum;
+                               },
+                                1 });
+        };
+        AddRays("primary", bench->PrimaryRays, RayType::Camera);
+        AddRays("secondary", bench->SecondaryRays, RayType::Bounce);
+
+        // one operation is one pixel at one sample, the rays it takes are counted by the intersector.
+        std::size_t const numPixels = std::size_t(resolution) * resolution;
+        kernels.push_back({ fmt::format("RayTrace/{}", bench->Name), [bench, resolution, numPixels](std::size_t const numOps) {
+                               float sum = 0;
+                               for (std::size_t k = 0; k < numOps; ++k) {
+                                   std::size_t const p   = k % numPixels;
+                                   Ray const         ray = GetCameraRay(bench->Scene.Cameras[0], resolution, p % resolution + .5f, p / resolution + .5f);
+                                   sum += RayTrace(bench->Intersector, ray, 3, true).x;
+                               }
+                               return sum;
+                           },
+                            0,
+                            &bench->Intersector });
+        kernels.push_back({ fmt::format("PathTrace/{}", bench->Name), [bench, resolution, numPixels](std::size_t const numOps) {
+                               float sum = 0;
+                               for (std::size_t k = 0; k < numOps; ++k) {
+                                   std::size_t const   p = k % numPixels;
+                                   std::uint32_t const i = std::uint32_t(p % resolution);
+                                   std::uint32_t const j = std::uint32_t(p / resolution);
+                                   Sampler             sampler(SamplerType::Sobol, i, j, std::uint32_t(k / numPixels));
+                                   glm::vec2 const     jitter = sampler.Get2D();
+                                   Ray const           ray    = GetCameraRay(bench->Scene.Cameras[0], resolution, i + jitter.x, j + jitter.y);
+                                   sum += PathTrace(bench->Intersector, ray, 5, sampler).x;
+                               }
+                               return sum;
+                           },
+                            0,
+                            &bench->Intersector });
+    }
+
+    static BenchResult Measure(Kernel const & kernel, BenchArgs const & args) {
+        using Clock        = std::chrono::steady_clock;
+        auto const Elapsed = [&](std::size_t const numOps) {
+            auto const start = Clock::now();
+            g_Sink           = kernel.Run(numOps);
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        };
+        // grows the batch until it takes MinTime, the calibration runs double as the warm-up.
+        std::size_t numOps = 1;
+        for (double seconds = Elapsed(numOps); seconds < args.MinTime; seconds = Elapsed(numOps))
+            numOps = std::size_t(numOps * std::clamp(1.25 * args.MinTime / std::max(seconds, 1e-9), 2., 100.));
+
+        std::vector<double> nsPerOp;
+        std::uint64_t const raysBefore = kernel.Intersector ? kernel.Intersector->GetRayCount() : 0;
+        double              total      = 0;
+        for (int r = 0; r < args.Repetitions; ++r) {
+            double const seconds = Elapsed(numOps);
+            total += seconds;
+            nsPerOp.push_back(seconds * 1e9 / numOps);
+        }
+        std::sort(nsPerOp.begin(), nsPerOp.end());
+        double const median = nsPerOp.size() % 2 ? nsPerOp[nsPerOp.size() / 2] : (nsPerOp[nsPerOp.size() / 2 - 1] + nsPerOp[nsPerOp.size() / 2]) / 2;
+        double const rays   = kernel.Intersector
+              ? double(kernel.Intersector->GetRayCount() - raysBefore)
+              : kernel.RaysPerOp * numOps * args.Repetitions;
+        return { kernel.Name, median, nsPerOp.front(), rays * 1e-6 / std::max(total, 1e-9), numOps };
+    }
+
+    static bool WriteJson(std::filesystem::path const & fileName, std::vector<BenchResult> const & results) {
+        std::ofstream file(fileName);
+        if (! file) {
+            spdlog::error("VCX::Labs::Rendering::WriteJson(\"{}\"): cannot write.", fileName.string());
+            return false;
+        }
+        file << "{\n  \"version\": 1,\n  \"benchmarks\": [\n";
+        for (std::size_t k = 0; k < results.size(); ++k) {
+            auto const & result = results[k];
+            file << fmt::format(
+                "    {{ \"name\": \"{}\", \"ns_per_op\": {:.3f}, \"min_ns_per_op\": {:.3f}, \"mrays_per_s\": {:.4f}, \"ops\": {} }}{}\n",
+                result.Name,
+                result.NsPerOp,
+                result.MinNsPerOp,
+                result.MRaysPerSec,
+                result.NumOps,
+                k + 1 < results.size() ? "," : "");
+        }
+        file << "  ]\n}\n";
+        return true;
+    }
+
+    // ns/op by kernel name, nullopt if the file cannot be read.
+    static std::optional<std::map<std::string, double>> ReadBaseline(std::filesystem::path const & fileName) {
+        try {
+            // JSON is read as YAML, of which it is a subset.
+            YAML::Node const              root = YAML::LoadFile(fileName.string());
+            std::map<std::string, double> baseline;
+            for (auto const & node : root["benchmarks"])
+                baseline[node["name"].as<std::string>()] = node["ns_per_op"].as<double>();
+            return baseline;
+        } catch (YAML::Exception const & e) {
+            spdlog::error("VCX::Labs::Rendering::ReadBaseline(\"{}\"): {}.", fileName.string(), e.what());
+            return std::nullopt;
+        }
+    }
+
+    static int Bench(BenchArgs const & args) {
+        std::optional<std::map<std::string, double>> baseline;
+        if (args.Baseline && ! (baseline = ReadBaseline(*args.Baseline))) return 2;
+
+        std::vector<Kernel> kernels;
+        AddTriangleKernel(kernels);
+        AddTextureKernels(kernels);
+        AddHaltonKernels(kernels);
+        std::vector<std::shared_ptr<SceneBench>> scenes;
+        for (auto const path : Assets::ExampleScenes) {
+            std::string const name = std::filesystem::path(path).stem().string();
+            if (! args.Scenes.empty() && std::find(args.Scenes.begin(), args.Scenes.end(), name) == args.Scenes.end()) continue;
+            // the scene is only loaded if the filter matches one of its kernels.
+            if (! args.Filter.empty()) {
+                auto const names = {
+                    fmt::format("IntersectRay/{}/primary", name),
+                    fmt::format("IntersectRay/{}/secondary", name),
+                    fmt::format("RayTrace/{}", name),
+                    fmt::format("PathTrace/{}", name),
+                };
+                if (std::none_of(names.begin(), names.end(), [&](std::string const & kernel) { return kernel.find(args.Filter) != std::string::npos; })) continue;
+            }
+            if (! std::filesystem::exists(path)) {
+                spdlog::warn("VCX::Labs::Rendering::Bench(..): skipped {}, \"{}\" is missing.", name, path);
+                continue;
+            }
+            auto bench   = std::make_shared<SceneBench>();
+            bench->Name  = name;
+            bench->Scene = Engine::LoadScene(path);
+            // the tree is built from scratch, so a stale cache cannot make two runs differ.
+            bench->Intersector.InitScene(&bench->Scene);
+            AddSceneKernels(kernels, bench, args.Resolution);
+            scenes.push_back(bench);
+        }
+
+        std::vector<BenchResult> results;
+        bool                     regressed = false;
+        fmt::print("{:<44} {:>12} {:>12} {:>10}{}\n", "kernel", "ns/op", "min ns/op", "Mrays/s", baseline ? "   baseline   change" : "");
+        for (auto const & kernel : kernels) {
+            if (! args.Filter.empty() && kernel.Name.find(args.Filter) == std::string::npos) continue;
+            BenchResult const result = Measure(kernel, args);
+            results.push_back(result);
+            std::string const mrays = result.MRaysPerSec > 0 ? fmt::format("{:.3f}", result.MRaysPerSec) : "-";
+            std::string comparison;
+            if (baseline) {
+                if (auto const it = baseline->find(result.Name); it != baseline->end()) {
+                    double const change = (result.NsPerOp / it->second - 1) * 100;
+                    bool const   slower = change > args.Threshold;
+                    regressed           = regressed || slower;
+                    comparison          = fmt::format(" {:>10.2f} {:>+7.1f}%{}", it->second, change, slower ? " slower" : change < -args.Threshold ? " faster" : "");
+                } else comparison = fmt::format(" {:>10} {:>8}", "-", "new");
+            }
+            fmt::print("{:<44} {:>12.2f} {:>12.2f} {:>10}{}\n", result.Name, result.NsPerOp, result.MinNsPerOp, mrays, comparison);
+        }
+
+        if (args.Output && ! WriteJson(*args.Output, results)) return 2;
+        if (regressed) spdlog::warn("VCX::Labs::Rendering::Bench(..): slower than the baseline by more than {}%.", args.Threshold);
+        return regressed ? 1 : 0;
+    }
+
+    // memory, build time and throughput of every BVH layout on each selected scene, from its first camera.
+    static int BenchLayouts(BenchArgs const & args) {
+        static char const * const layoutNames[] = { "binary", "8-wide", "8-wide quantized" };
+        fmt::print("{:<16} {:<18} {:>10} {:>14} {:>10} {:>16} {:>18}\n", "scene", "layout", "nodes MB", "triangles MB", "build ms", "primary Mrays/s", "secondary Mrays/s");
+        for (auto const path : Assets::ExampleScenes) {
+            std::string const name = std::filesystem::path(path).stem().string();
+            if (! args.Scenes.empty() && std::find(args.Scenes.begin(), args.Scenes.end(), name) == args.Scenes.end()) continue;
+            if (! std::filesystem::exists(path)) {
+                spdlog::warn("VCX::Labs::Rendering::BenchLayouts(..): skipped {}, \"{}\" is missing.", name, path);
+                continue;
+            }
+            Engine::Scene const scene = Engine::LoadScene(path);
+            if (scene.Cameras.empty()) continue;
+            for (auto const & result : BenchmarkBVHLayouts(scene, scene.Cameras[0], { }, args.Resolution))
+                fmt::print(
+                    "{:<16} {:<18} {:>10.2f} {:>14.2f} {:>10.1f} {:>16.3f} {:>18.3f}\n",
+                    name,
+                    layoutNames[int(result.Layout)],
+                    result.NodeBytes / 1048576.,
+                    result.PrimitiveBytes / 1048576.,
+                    result.BuildTime,
+                    result.PrimaryMRays,
+                    result.SecondaryMRays);
+        }
+        return 0;
+    }
+
+} // namespace VCX::Labs::Rendering
+
+int main(int argc, char ** argv) {
+    using namespace VCX::Labs::Rendering;
+    auto const args = ParseArgs(argc, argv);
+    if (! args) return 2;
+    if (args->Help) return 0;
+#ifndef NDEBUG
+    spdlog::warn("VCX::Labs::Rendering::Bench(..): built without optimizations, the timings are not representative.");
+#endif
+    return args->Layouts ? BenchLayouts(*args) : Bench(*args);
+}
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "Engine/loader.h"
+#include "Engine/Trace.h"
+#include "Labs/Common/ImageRGB.h"
+#include "Labs/Final_Project/CostMap.h"
+#include "Labs/Final_Project/Sampler.h"
+#include "Labs/Final_Project/TileRenderer.h"
+#include "Labs/Final_Project/tasks.h"
+
+// renders one scene without a window or an OpenGL context and writes the image to disk,
+// for machines without a display. the camera rays and shading match CaseRayTracing and CasePathTracing.
+
+namespace VCX::Labs::Rendering {
+
+    enum class Integrator {
+        Whitted,
+        Path,
+    };
+
+    struct RenderArgs {
+        std::filesystem::path    Scene;
+        std::filesystem::path    Output { "render.png" };
+        std::filesystem::path    Statistics; // ray statistics as JSON, empty to skip
+        std::filesystem::path    Trace;      // Chrome trace events of loading, building and rendering, empty to skip
+        std::filesystem::path    CostMap;    // per-pixel cost heat map, empty to skip measuring
+        CostMetric               Metric { CostMetric::Time };
+        std::uint32_t            Width { 1024 };
+        std::uint32_t            Height { 768 };
+        int                      SamplesPerPixel { 16 };
+        Integrator               Method { Integrator::Path };
+        SamplerType              Sequence { SamplerType::Sobol };
+        int                      NumThreads { 0 };
+        std::optional<int>       MaximumDepth; // 3 for Whitted, 5 for path tracing, as in the GUI
+        bool                     EnableShadow { true };
+        AccelerationStructure    Structure { AccelerationStructure::BVH };
+        std::size_t              CameraIndex { 0 };
+        std::optional<glm::vec3> Eye;
+        std::optional<glm::vec3> Target;
+        std::optional<float>     Fovy;
+        bool                     Help { false }; // usage was printed for --help, nothing to render
+    };
+
+    static constexpr char const * c_Usage =
+        "usage: render-cli <scene.yaml> [options]\n"
+        "  -o, --output <file.png>        image to write (render.png)\n"
+        "      --stats <file.json>        also writes the ray statistics\n"
+        "      --trace <file.json>        also writes a Chrome trace of loading, building and rendering\n"
+        "      --cost-map <file.png>      also writes the cost per sample of every pixel as a heat map\n"
+        "      --cost-metric time|traversal\n"
+        "                                 what the heat map shows (time)\n"
+        "  -r, --resolution <w>x<h>       image size in pixels (1024x768)\n"
+        "  -s, --spp <n>                  samples per pixel (16), rounded down to a square grid for whitted\n"
+        "  -i, --integrator whitted|path  shading of CaseRayTracing or CasePathTracing (path)\n"
+        "      --sampler independent|halton|sobol|bluenoise\n"
+        "                                 path tracing sample sequence (sobol)\n"
+        "  -t, --threads <n>              worker threads, 0 for one per core (0)\n"
+        "  -d, --depth <n>                maximum ray depth (3 for whitted, 5 for path)\n"
+        "      --no-shadow                whitted without shadow rays\n"
+        "      --accel bvh|kdtree         acceleration structure (bvh)\n"
+        "  -c, --camera <i>               camera of the scene file (0)\n"
+        "      --eye <x,y,z>              overrides the camera position\n"
+        "      --target <x,y,z>           overrides the camera target\n"
+        "      --fovy <degrees>           overrides the vertical field of view\n";
+
+    static std::optional<glm::vec3> ParseVec3(std::string const & text) {
+        glm::vec3 v;
+        if (std::sscanf(text.c_str(), "%f,%f,%f", &v.x, &v.y, &v.z) != 3) return std::nullopt;
+        return v;
+    }
+
+    // returns nullopt after reporting the first malformed argument, and arguments with Help set after printing the usage.
+    static std::optional<RenderArgs> ParseArgs(int argc, char ** argv) {
+        RenderArgs args;
+        for (int k = 1; k < argc; ++k) {
+            std::string_view const arg = argv[k];
+            auto const             Next = [&]() -> std::optional<std::string> {
+                if (k + 1 >= argc) return std::nullopt;
+                return std::string(argv[++k]);
+            };
+            auto const Fail = [&](char const * reason) -> std::optional<RenderArgs> {
+                spdlog::error("VCX::Labs::Rendering::ParseArgs(..): {} for \"{}\".", reason, arg);
+                return std::nullopt;
+            };
+            if (arg == "--help") {
+                std::fputs(c_Usage, stdout);
+                args.Help = true;
+                return args;
+            } else if (arg == "-o" || arg == "--output") {
+                auto const value = Next();
+                if (! value) return Fail("missing file name");
+                args.Output = *value;
+            } else if (arg == "--stats") {
+                auto const value = Next();
+                if (! value) return Fail("missing file name");
+                args.Statistics = *value;
+            } else if (arg == "--trace") {
+                auto const value = Next();
+                if (! value) return Fail("missing file name");
+                args.Trace = *value;
+            } else if (arg == "--cost-map") {
+                auto const value = Next();
+                if (! value) return Fail("missing file name");
+                args.CostMap = *value;
+            } else if (arg == "--cost-metric") {
+                auto const value = Next();
+                if (value == "time") args.Metric = CostMetric::Time;
+                else if (value == "traversal") args.Metric = CostMetric::Traversal;
+                else return Fail("expected time or traversal");
+            } else if (arg == "-r" || arg == "--resolution") {
+                auto const value = Next();
+                if (! value || std::sscanf(value->c_str(), "%ux%u", &args.Width, &args.Height) != 2 || ! args.Width || ! args.Height)
+                    return Fail("expected <width>x<height>");
+            } else if (arg == "-s" || arg == "--spp") {
+                auto const value = Next();
+                if (! value || (args.SamplesPerPixel = std::atoi(value->c_str())) < 1) return Fail("expected a positive count");
+            } else if (arg == "-i" || arg == "--integrator") {
+                auto const value = Next();
+                if (value == "whitted") args.Method = Integrator::Whitted;
+                else if (value == "path") args.Method = Integrator::Path;
+                else return Fail("expected whitted or path");
+            } else if (arg == "--sampler") {
+                auto const value = Next();
+                if (value == "independent") args.Sequence = SamplerType::Independent;
+                else if (value == "halton") args.Sequence = SamplerType::Halton;
+                else if (value == "sobol") args.Sequence = SamplerType::Sobol;
+                else if (value == "bluenoise") args.Sequence = SamplerType::BlueNoise;
+                else return Fail("expected independent, halton, sobol or bluenoise");
+            } else if (arg == "-t" || arg == "--threads") {
+                auto const value = Next();
+                if (! value || (args.NumThreads = std::atoi(value->c_str())) < 0) return Fail("expected a count");
+            } else if (arg == "-d" || arg == "--depth") {
+                auto const value = Next();
+                if (! value || (args.MaximumDepth = std::atoi(value->c_str())) < 1) return Fail("expected a positive depth");
+            } else if (arg == "--no-shadow") {
+                args.EnableShadow = false;
+            } else if (arg == "--accel") {
+                auto const value = Next();
+                if (value == "bvh") args.Structure = AccelerationStructure::BVH;
+                else if (value == "kdtree") args.Structure = AccelerationStructure::KdTree;
+                else return Fail("expected bvh or kdtree");
+            } else if (arg == "-c" || arg == "--camera") {
+                auto const value = Next();
+                if (! value) return Fail("missing camera index");
+                args.CameraIndex = std::size_t(std::atoi(value->c_str()));
+            } else if (arg == "--eye" || arg == "--target") {
+                auto const value = Next();
+                auto const v     = value ? ParseVec3(*value) : std::nullopt;
+                if (! v) return Fail("expected <x,y,z>");
+                (arg == "--eye" ? args.Eye : args.Target) = v;
+            } else if (arg == "--fovy") {
+                auto const value = Next();
+                if (! value || (args.Fovy = float(std::atof(value->c_str()))) <= 0) return Fail("expected degrees");
+            } else if (arg.starts_with('-') || ! args.Scene.empty()) {
+                return Fail("unexpected argument");
+            } else args.Scene = arg;
+        }
+        if (args.Scene.empty()) {
+            std::fputs(c_Usage, stderr);
+            return std::nullopt;
+        }
+        return args;
+    }
+
+    static int Render(RenderArgs const & args) {
+        if (! std::filesystem::exists(args.Scene)) {
+            spdlog::error("VCX::Labs::Rendering::Render(..): cannot find scene \"{}\".", args.Scene.string());
+            return 1;
+        }
+        Engine::Scene const scene = Engine::LoadScene(args.Scene);
+        if (args.CameraIndex >= scene.Cameras.size()) {
+            spdlog::error("VCX::Labs::Rendering::Render(..): the scene has {} camera(s), no camera {}.", scene.Cameras.size(), args.CameraIndex);
+            return 1;
+        }
+        Engine::Camera camera = scene.Cameras[args.CameraIndex];
+        if (args.Eye) camera.Eye = *args.Eye;
+        if (args.Target) camera.Target = *args.Target;
+        if (args.Fovy) camera.Fovy = *args.Fovy;
+
+        RayIntersector intersector;
+        intersector.Structure      = args.Structure;
+        intersector.CacheDirectory = args.Scene.parent_path() / ".bvhcache";
+        intersector.InitScene(&scene);
+
+        bool const        isPath       = args.Method == Integrator::Path;
+        int const         maximumDepth = args.MaximumDepth.value_or(isPath ? 5 : 3);
+        int const         gridSize     = std::max(1, int(std::sqrt(float(args.SamplesPerPixel))));
+        auto const        width        = args.Width;
+        auto const        height       = args.Height;
+        SamplerType const samplerType  = args.Sequence;
+        if (isPath && samplerType == SamplerType::BlueNoise) Sampler::LoadBlueNoise();
+        if (! isPath && gridSize * gridSize != args.SamplesPerPixel)
+            spdlog::warn("VCX::Labs::Rendering::Render(..): whitted samples a square grid, using {} spp.", gridSize * gridSize);
+
+        glm::vec3 const lookDir   = glm::normalize(camera.Target - camera.Eye);
+        glm::vec3 const rightDir  = glm::normalize(glm::cross(lookDir, camera.Up));
+        glm::vec3 const upDir     = glm::normalize(glm::cross(rightDir, lookDir));
+        float const     aspect    = width * 1.f / height;
+        float const     fovFactor = std::tan(glm::radians(camera.Fovy) / 2);
+        auto const      GetRay    = [&](float const x, float const y) {
+            glm::vec3 dir = lookDir;
+            dir += fovFactor * (2.0f * y / height - 1.0f) * upDir;
+            dir += fovFactor * aspect * (2.0f * x / width - 1.0f) * rightDir;
+            return Ray(camera.Eye, glm::normalize(dir));
+        };
+
+        Common::ImageRGB  image(width, height);
+        TileRenderer      renderer;
+        Engine::CancellationToken const token; // never cancelled
+        renderer.Options.NumThreads = args.NumThreads;
+        renderer.Options.Order      = TraversalOrder::Hilbert;
+        intersector.ResetRayStatistics();
+
+        CostMap    costMap;
+        bool const measure = ! args.CostMap.empty();
+        auto const Shade   = [&](std::size_t const i, std::size_t const j, int const samples, auto && shade) {
+            return measure ? costMap.Measure(i, j, samples, shade) : shade();
+        };
+        if (measure) costMap.Reset(width, height);
+        auto const start = std::chrono::steady_clock::now();
+        if (isPath) {
+            // in passes as in CasePathTracing, so the Halton batch stays small for any sample count.
+            int const              passSamples = std::min(args.SamplesPerPixel, 64);
+            std::vector<glm::vec3> sums(std::size_t(width) * height, glm::vec3(0));
+            HaltonBatch            haltonBatch;
+            for (int first = 0; first < args.SamplesPerPixel; first += passSamples) {
+                int const numSamples = std::min(passSamples, args.SamplesPerPixel - first);
+                if (samplerType == SamplerType::Halton) haltonBatch.Generate(std::uint32_t(first), std::uint32_t(numSamples), 16);
+                renderer.Reset();
+                renderer.Render(
+                    image,
+                    [&](std::size_t const i, std::size_t const j) {
+                        return Shade(i, j, numSamples, [&]() {
+                            glm::vec3 sum(0.0f);
+                            for (int k = 0; k < numSamples; ++k) {
+                                Sampler         sampler(samplerType, std::uint32_t(i), std::uint32_t(j), std::uint32_t(first + k), &haltonBatch);
+                                glm::vec2 const jitter = sampler.Get2D();
+                                sum += PathTrace(intersector, GetRay(i + jitter.x, j + jitter.y), maximumDepth, sampler);
+                            }
+                            return sum;
+                        });
+                    },
+                    token,
+                    [&](std::size_t const i, std::size_t const j, glm::vec3 const & value) {
+                        glm::vec3 & sum = sums[j * width + i];
+                        sum += value;
+                        return sum / float(first + numSamples);
+                    });
+                double const passEnd = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                intersector.GetRayStatistics().AddPass(passEnd - intersector.GetRayStatistics().GetPassTime());
+                spdlog::info("VCX::Labs::Rendering::Render(..): {}/{} spp.", first + numSamples, args.SamplesPerPixel);
+            }
+        } else {
+            renderer.Reset();
+            renderer.Render(image, [&](std::size_t const i, std::size_t const j) {
+                return Shade(i, j, gridSize * gridSize, [&]() {
+                    glm::vec3   sum(0.0f);
+                    float const step = 1.0f / gridSize;
+                    for (int dy = 0; dy < gridSize; ++dy)
+                        for (int dx = 0; dx < gridSize; ++dx) {
+                            glm::vec3 const res = RayTrace(intersector, GetRay(i + step * (0.5f + dx), j + step * (0.5f + dy)), maximumDepth, args.EnableShadow);
+                            sum += glm::pow(res, glm::vec3(1.0 / 2.2));
+                        }
+                    return sum / float(gridSize * gridSize);
+                });
+            }, token);
+        }
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (! isPath) intersector.GetRayStatistics().AddPass(seconds);
+        spdlog::info(
+            "VCX::Labs::Rendering::Render(..): {}x{} in {:.2f} s, {:.3f} Mrays/s.",
+            width,
+            height,
+            seconds,
+            intersector.GetRayCount() * 1e-6 / std::max(seconds, 1e-9));
+
+        // row 0 is the bottom of the view.
+        if (! Engine::SaveImagePNG(args.Output, image, true)) return 1;
+        spdlog::info("VCX::Labs::Rendering::Render(..): saved \"{}\".", args.Output.string());
+        if (! args.Statistics.empty() && ! WriteRayStatistics(args.Statistics, intersector.GetRayStatistics())) return 1;
+        if (measure) {
+            float scale;
+            if (! Engine::SaveImagePNG(args.CostMap, costMap.GetImage(args.Metric, scale), true)) return 1;
+            spdlog::info(
+                "VCX::Labs::Rendering::Render(..): saved \"{}\", white is {:.2f} {} per sample.",
+                args.CostMap.string(),
+                scale,
+                args.Metric == CostMetric::Time ? "us" : "steps");
+        }
+        return 0;
+    }
+
+} // namespace VCX::Labs::Rendering
+
+int main(int argc, char ** argv) {
+    using namespace VCX::Labs::Rendering;
+    auto const args = ParseArgs(argc, argv);
+    if (! args) return 2;
+    if (args->Help) return 0;
+    if (! args->Trace.empty()) VCX::Engine::Tracer::Get().Start();
+    int const result = Render(*args);
+    if (! args->Trace.empty() && ! VCX::Engine::Tracer::Get().Stop(args->Trace)) return 1;
+    return result;
+}
@@ -1,6 +1,5 @@
 #include "Labs/Final_Project/tasks.h"
 #include <algorithm>
-#include <random>
 
 namespace VCX::Labs::Rendering {
 
@@ -23,6 +22,40 @@ namespace VCX::Labs::Rendering {
         return glm::vec4(glm::pow(diffuseColor, glm::vec3(2.2)), albedo.w);
     }
 
+    float GetAlpha(RenderScene const & scene, std::size_t const modelIdx, std::size_t const meshIdx, float const u, float const v) {
+        RenderModel const &   model   = scene.GetModel(modelIdx);
+        std::uint32_t const * face    = model.Mesh->Indices.data() + meshIdx;
+        glm::vec2 const       uvCoord = (1.0f - u - v) * model.TexCoords[face[0]] + u * model.TexCoords[face[1]] + v * model.TexCoords[face[2]];
+        return GetTexture(model.Material->Albedo, uvCoord).w;
+    }
+
+    RayHit GetRayHit(RenderScene const & scene, std::size_t const modelIdx, std::size_t const meshIdx, float const u, float const v) {
+        RayHit                result;
+        RenderModel const &   model     = scene.GetModel(modelIdx);
+        auto const &          normals   = model.Normals;
+        auto const &          texcoords = model.TexCoords;
+        std::uint32_t const * face      = model.Mesh->Indices.data() + meshIdx;
+        glm::vec3 const &     p1        = model.Mesh->Positions[face[0]];
+        glm::vec3 const &     p2        = model.Mesh->Positions[face[1]];
+        glm::vec3 const &     p3        = model.Mesh->Positions[face[2]];
+        glm::vec3 const &     n1        = normals[face[0]];
+        glm::vec3 const &     n2        = normals[face[1]];
+        glm::vec3 const &     n3        = normals[face[2]];
+        glm::vec2 const &     uv1       = texcoords[face[0]];
+        glm::vec2 const &     uv2       = texcoords[face[1]];
+        glm::vec2 const &     uv3       = texcoords[face[2]];
+        result.IntersectState           = true;
+        auto const & material           = *model.Material;
+        result.IntersectMode            = material.Blend;
+        result.IntersectPosition        = (1.0f - u - v) * p1 + u * p2 + v * p3;
+        result.IntersectNormal          = (1.0f - u - v) * n1 + u * n2 + v * n3;
+        result.IntersectFaceNormal      = model.FaceNormals[meshIdx / 3];
+        glm::vec2 uvCoord               = (1.0f - u - v) * uv1 + u * uv2 + v * uv3;
+        result.IntersectAlbedo          = GetAlbedo(material, uvCoord);
+        result.IntersectMetaSpec        = GetTexture(material.MetaSpec, uvCoord);
+        return result;
+    }
+
     /******************* 1. Ray-triangle intersection *****************/
     bool IntersectTriangle(Intersection & output, Ray const & ray, glm::vec3 const & p1, glm::vec3 const & p2, glm::vec3 const & p3) {
         // your code here
@@ -56,6 +89,8 @@ namespace VCX::Labs::Rendering {
     }
 
     float halton(int index, int base) {
+        if (int const baseIndex = RadicalInverse::FindBase(base); baseIndex >= 0 && index >= 0)
+            return RadicalInverse::GetPlain()(baseIndex, std::uint32_t(index));
         float f = 1.0f / base;
         float r = 0.0f;
         int   i = index;
@@ -71,9 +106,11 @@ namespace VCX::Labs::Rendering {
         glm::vec3 color(0.0f);
         glm::vec3 weight(1.0f);
 
-        for (int depth = 0; depth < maxDepth; depth++) {
-            auto rayHit = intersector.IntersectRay(ray);
-            if (! rayHit.IntersectState) return color;
+        int depth = 0;
+        for (; depth < maxDepth; depth++) {
+            AccelHit hit;
+            if (! intersector.Intersect(ray, hit, depth == 0 ? RayType::Camera : RayType::Bounce)) break;
+            const RayHit    rayHit    = intersector.ResolveSurface(hit);
             const glm::vec3 pos       = rayHit.IntersectPosition;
             const glm::vec3 n         = rayHit.IntersectNormal;
             const glm::vec3 kd        = rayHit.IntersectAlbedo;
@@ -94,24 +131,14 @@ namespace VCX::Labs::Rendering {
                     attenuation = 1.0f / glm::dot(l, l);
                     if (enableShadow) {
                         // your code here
-                        auto hit = intersector.IntersectRay(Ray(pos, l));
-                        if (hit.IntersectState == true && hit.IntersectAlbedo.w >= 0.2f) {
-                            glm::vec3 shadow_pos = hit.IntersectPosition;
-                            glm::vec3 shadow_dir = light.Position - shadow_pos;
-                            if (glm::dot(shadow_dir, l) > 0) {
-                                continue;
-                            }
-                        }
+                        if (intersector.Occluded(Ray(pos, l), glm::length(l), 0.2f)) continue;
                     }
                 } else if (light.Type == Engine::LightType::Directional) {
                     l           = light.Direction;
                     attenuation = 1.0f;
                     if (enableShadow) {
                         // your code here
-                        auto hit = intersector.IntersectRay(Ray(pos, l));
-                        if (hit.IntersectState == true && hit.IntersectAlbedo.w >= 0.2f) {
-                            continue;
-                        }
+                        if (intersector.Occluded(Ray(pos, l), 1e7f, 0.2f)) continue;
                     }
                 }
 
@@ -151,12 +178,13 @@ namespace VCX::Labs::Rendering {
             }
         }
 
+        intersector.GetRayStatistics().AddPath(std::uint32_t(depth), false);
         return color;
     }
 
 #define EPS1 1e-4f
 
-    glm::vec3 PathTrace(const RayIntersector & intersector, Ray ray, int maxDepth, int pixel_samples, int seed) {
+    glm::vec3 PathTrace(const RayIntersector & intersector, Ray ray, int maxDepth, Sampler & sampler) {
         glm::vec3   color(0.0f);
         glm::vec3   throughput(1.0f);
         const float color_rate   = 2.5f;
@@ -164,15 +192,15 @@ namespace VCX::Labs::Rendering {
         const int   samples      = 8;
         const float light_radius = 10.0f;
 
-        std::mt19937                          gen(seed);
-        std::uniform_real_distribution<float> dis(0.0f, 1.0f);
-
-        for (int depth = 0; depth < maxDepth; ++depth) {
-            auto rayHit = intersector.IntersectRay(ray);
-            if (! rayHit.IntersectState) {
+        int  depth    = 0;
+        bool roulette = false;
+        for (; depth < maxDepth; ++depth) {
+            AccelHit hit;
+            if (! intersector.Intersect(ray, hit, depth == 0 ? RayType::Camera : RayType::Bounce)) {
                 color += throughput * glm::vec3(0.0f, 0.0f, 0.0f);
                 break;
             }
+            const RayHit rayHit = intersector.ResolveSurface(hit);
 
             const glm::vec3 pos             = rayHit.IntersectPosition;
             const glm::vec3 nl              = glm::normalize(rayHit.IntersectNormal);
@@ -186,11 +214,12 @@ namespace VCX::Labs::Rendering {
                 glm::vec3 light_total = glm::vec3(0.0f);
                 for (int s = 0; s < samples; s++) {
                     glm::vec3 l;
+                    glm::vec2 u               = sampler.Get2D();
                     float     attenuation     = 1.0f;
                     glm::vec3 sampledLightPos = light.Position;
                     if (light.Type == Engine::LightType::Point) {
-                        float     u1   = dis(gen);
-                        float     u2   = dis(gen);
+                        float     u1   = u.x;
+                        float     u2   = u.y;
                         float     z    = 1.0f - 2.0f * u1;
                         float     r_xy = sqrt(1.0f - z * z);
                         float     phi  = 2.0f * glm::pi<float>() * u2;
@@ -206,9 +235,8 @@ namespace VCX::Labs::Rendering {
                     l = glm::normalize(l);
 
                     // Shadow ray
-                    Ray  shadowRay(pos + n * EPS1, l);
-                    auto shadowHit = intersector.IntersectRay(shadowRay);
-                    if (! shadowHit.IntersectState || glm::distance(pos, shadowHit.IntersectPosition) > glm::distance(pos, sampledLightPos)) {
+                    Ray shadowRay(pos + n * EPS1, l);
+                    if (! intersector.Occluded(shadowRay, glm::distance(shadowRay.Origin, sampledLightPos))) {
                         float     cosTheta       = glm::max(glm::dot(n, l), 0.0f);
                         glm::vec3 diffuse_color  = kd * cosTheta * attenuation * light.Intensity * color_rate;
                         glm::vec3 norm_eye       = glm::normalize(-ray.Direction);
@@ -227,7 +255,10 @@ namespace VCX::Labs::Rendering {
 
             glm::vec3 newDir;
             glm::vec3 bsdf_contribution;
-            float     r_brdf = dis(gen);
+            // drawn whichever lobe is taken, so that the next vertex starts at the same dimension on every path.
+            float     r_brdf = sampler.Get1D();
+            glm::vec2 r      = sampler.Get2D();
+            float     rr     = sampler.Get1D();
 
             if (r_brdf < specular_weight && specular_weight > 0.01f) {
                 newDir            = glm::reflect(ray.Direction, n);
@@ -236,8 +267,8 @@ namespace VCX::Labs::Rendering {
 
                 throughput *= bsdf_contribution / specular_weight;
             } else {
-                float r1       = dis(gen);
-                float r2       = dis(gen);
+                float r1       = r.x;
+                float r2       = r.y;
                 float phi      = 2.0f * glm::pi<float>() * r1;
                 float cosTheta = sqrt(r2);
                 float sinTheta = sqrt(1.0f - r2);
@@ -258,9 +289,14 @@ namespace VCX::Labs::Rendering {
             // Russian roulette
             float p = glm::max(throughput.r, glm::max(throughput.g, throughput.b));
             p       = glm::max(p, 0.15f);
-            if (depth > 3 && dis(gen) > p) break;
+            if (depth > 3 && rr > p) {
+                roulette = true;
+                ++depth;
+                break;
+            }
             if (depth > 3) throughput /= p;
         }
+        intersector.GetRayStatistics().AddPath(std::uint32_t(depth), roulette);
         return color;
     }
 } // namespace VCX::Labs::Rendering
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <filesystem>
 #include <numeric>
 #include <spdlog/spdlog.h>
 
 #include "Engine/Scene.h"
+#include "Engine/Trace.h"
+#include "Labs/Final_Project/BVH.h"
+#include "Labs/Final_Project/KdTree.h"
 #include "Labs/Final_Project/Ray.h"
+#include "Labs/Final_Project/RayStatistics.h"
+#include "Labs/Final_Project/RenderScene.h"
+#include "Labs/Final_Project/Sampler.h"
 
 namespace VCX::Labs::Rendering {
 
@@ -16,6 +24,9 @@ namespace VCX::Labs::Rendering {
 
     glm::vec4 GetAlbedo(Engine::Material const & material, glm::vec2 const & uvCoord);
 
+    // albedo alpha of the meshIdx-th index triple of model modelIdx at barycentric (u, v), without the rest of GetRayHit(..).
+    float GetAlpha(RenderScene const & scene, std::size_t const modelIdx, std::size_t const meshIdx, float const u, float const v);
+
     struct Intersection {
         float t, u, v; // ray parameter t, barycentric coordinates (u, v)
     };
@@ -27,10 +38,14 @@ namespace VCX::Labs::Rendering {
         Engine::BlendMode IntersectMode;
         glm::vec3         IntersectPosition;
         glm::vec3         IntersectNormal;
+        glm::vec3         IntersectFaceNormal; // geometric normal of the triangle
         glm::vec4         IntersectAlbedo;   // [Albedo   (vec3), Alpha     (float)]
         glm::vec4         IntersectMetaSpec; // [Specular (vec3), Shininess (float)]
     };
 
+    // interpolates the surface attributes of the meshIdx-th index triple of model modelIdx at barycentric (u, v).
+    RayHit GetRayHit(RenderScene const & scene, std::size_t const modelIdx, std::size_t const meshIdx, float const u, float const v);
+
     struct TrivialRayIntersector {
         Engine::Scene const * InternalScene = nullptr;
 
@@ -38,14 +53,13 @@ namespace VCX::Labs::Rendering {
 
         void InitScene(Engine::Scene const * scene) {
             InternalScene = scene;
+            _renderScene.Build(*scene);
         }
 
-        RayHit IntersectRay(Ray const & ray) const {
-            RayHit result;
+        bool Intersect(Ray const & ray, AccelHit & hit) const {
             if (! InternalScene) {
-                spdlog::warn("VCX::Labs::Rendering::RayIntersector::IntersectRay(..): uninitialized intersector.");
-                result.IntersectState = false;
-                return result;
+                spdlog::warn("VCX::Labs::Rendering::RayIntersector::Intersect(..): uninitialized intersector.");
+                return false;
             }
             int          modelIdx, meshIdx;
             Intersection its;
@@ -64,44 +78,157 @@ namespace VCX::Labs::Rendering {
                     tmin = its.t, umin = its.u, vmin = its.v, modelIdx = i, meshIdx = j;
                 }
             }
-            if (tmin == 1e7) {
-                result.IntersectState = false;
-                return result;
-            }
-            auto const &          model     = InternalScene->Models[modelIdx];
-            auto const &          normals   = model.Mesh.IsNormalAvailable() ? model.Mesh.Normals : model.Mesh.ComputeNormals();
-            auto const &          texcoords = model.Mesh.IsTexCoordAvailable() ? model.Mesh.TexCoords : model.Mesh.GetEmptyTexCoords();
-            std::uint32_t const * face      = model.Mesh.Indices.data() + meshIdx;
-            glm::vec3 const &     p1        = model.Mesh.Positions[face[0]];
-            glm::vec3 const &     p2        = model.Mesh.Positions[face[1]];
-            glm::vec3 const &     p3        = model.Mesh.Positions[face[2]];
-            glm::vec3 const &     n1        = normals[face[0]];
-            glm::vec3 const &     n2        = normals[face[1]];
-            glm::vec3 const &     n3        = normals[face[2]];
-            glm::vec2 const &     uv1       = texcoords[face[0]];
-            glm::vec2 const &     uv2       = texcoords[face[1]];
-            glm::vec2 const &     uv3       = texcoords[face[2]];
-            result.IntersectState           = true;
-            auto const & material           = InternalScene->Materials[model.MaterialIndex];
-            result.IntersectMode            = material.Blend;
-            result.IntersectPosition        = (1.0f - umin - vmin) * p1 + umin * p2 + vmin * p3;
-            result.IntersectNormal          = (1.0f - umin - vmin) * n1 + umin * n2 + vmin * n3;
-            glm::vec2 uvCoord               = (1.0f - umin - vmin) * uv1 + umin * uv2 + vmin * uv3;
-            result.IntersectAlbedo          = GetAlbedo(material, uvCoord);
-            result.IntersectMetaSpec        = GetTexture(material.MetaSpec, uvCoord);
-
-            return result;
+            if (tmin == 1e7) return false;
+            hit = { tmin, umin, vmin, std::uint32_t(modelIdx), std::uint32_t(meshIdx) };
+            return true;
+        }
+
+        RayHit ResolveSurface(AccelHit const & hit) const {
+            return GetRayHit(_renderScene, hit.ModelIndex, hit.FaceIndex, hit.U, hit.V);
         }
+
+        RayHit IntersectRay(Ray const & ray) const {
+            AccelHit hit;
+            if (! Intersect(ray, hit)) return RayHit { .IntersectState = false };
+            return ResolveSurface(hit);
+        }
+
+    private:
+        RenderScene _renderScene;
     };
 
-    /* Optional: write your own accelerated intersector here */
+    enum class AccelerationStructure {
+        BVH,
+        KdTree,
+    };
+
+    // the build settings of a RayIntersector as one value, so that the UI can edit its own copy while a
+    // tracing thread builds from another one.
+    struct IntersectorOptions {
+        AccelerationStructure Structure = AccelerationStructure::BVH;
+        BVHBuildOptions       BVHOptions;
+        KdTreeBuildOptions    KdTreeOptions;
+        std::filesystem::path CacheDirectory;
+
+        bool operator==(IntersectorOptions const &) const = default;
+    };
+
+    // dispatches to the acceleration structure selected when InitScene(..) was last called.
+    struct RayIntersector {
+        Engine::Scene const * InternalScene = nullptr;
+        AccelerationStructure Structure     = AccelerationStructure::BVH;
+        BVHBuildOptions       BVHOptions;
+        KdTreeBuildOptions    KdTreeOptions;
+        std::filesystem::path CacheDirectory; // where bottom-level BVHs persist across runs, empty to disable
+
+        RayIntersector() = default;
+
+        // takes effect on the next InitScene(..).
+        void SetOptions(IntersectorOptions const & options) {
+            Structure      = options.Structure;
+            BVHOptions     = options.BVHOptions;
+            KdTreeOptions  = options.KdTreeOptions;
+            CacheDirectory = options.CacheDirectory;
+        }
+
+        void InitScene(Engine::Scene const * scene) {
+            Engine::TraceScope const trace("InitScene", "build");
+            InternalScene = scene;
+            _structure    = Structure;
+            _bvh.Clear();
+            _kdTree.Clear();
+            if (_structure == AccelerationStructure::KdTree) _kdTree.Build(*scene, KdTreeOptions);
+            else _bvh.Build(*scene, BVHOptions, CacheDirectory);
+            _renderScene.Build(*scene);
+        }
 
-    using RayIntersector = TrivialRayIntersector;
+        // closest hit along the ray, geometry only: t, barycentrics and the triangle it belongs to.
+        // type only decides which counter of GetRayStatistics() the ray goes to.
+        bool Intersect(Ray const & ray, AccelHit & hit, RayType const type = RayType::Bounce) const {
+            if (! InternalScene) {
+                spdlog::warn("VCX::Labs::Rendering::RayIntersector::Intersect(..): uninitialized intersector.");
+                return false;
+            }
+            bool const found = _structure == AccelerationStructure::KdTree
+                ? _kdTree.Intersect(ray, EPS1, 1e7, hit)
+                : _bvh.Intersect(ray, EPS1, 1e7, hit);
+            CountRay(type);
+            return found;
+        }
+
+        // interpolated attributes and texture lookups for a hit returned by Intersect(..), only needed for shading.
+        RayHit ResolveSurface(AccelHit const & hit) const {
+            return GetRayHit(_renderScene, hit.ModelIndex, hit.FaceIndex, hit.U, hit.V);
+        }
+
+        // Intersect(..) followed by ResolveSurface(..).
+        RayHit IntersectRay(Ray const & ray, RayType const type = RayType::Bounce) const {
+            AccelHit hit;
+            if (! Intersect(ray, hit, type)) return RayHit { .IntersectState = false };
+            return ResolveSurface(hit);
+        }
+
+        // whether anything lies between ray.Origin and tMax along the ray, stopping at the first hit.
+        // with alphaThreshold > 0, hits whose albedo alpha is below it are ignored; alpha is only
+        // looked up on models whose albedo texture is not fully opaque (RenderModel::Translucent).
+        bool Occluded(Ray const & ray, float const tMax, float const alphaThreshold = 0.f) const {
+            if (! InternalScene) {
+                spdlog::warn("VCX::Labs::Rendering::RayIntersector::Occluded(..): uninitialized intersector.");
+                return false;
+            }
+            struct AlphaTest {
+                RayIntersector const * Self;
+                float                  Threshold;
+            };
+            AlphaTest const test { this, alphaThreshold };
+            AnyHitFilter    filter;
+            if (alphaThreshold > 0) {
+                filter.Accept = [](void const * context, AccelHit const & hit) {
+                    auto const & [self, threshold] = *static_cast<AlphaTest const *>(context);
+                    auto const & scene             = self->_renderScene;
+                    return ! scene.GetModel(hit.ModelIndex).Translucent || GetAlpha(scene, hit.ModelIndex, hit.FaceIndex, hit.U, hit.V) >= threshold;
+                };
+                filter.Context = &test;
+            }
+            bool const occluded = _structure == AccelerationStructure::KdTree
+                ? _kdTree.Occluded(ray, EPS1, tMax, filter)
+                : _bvh.Occluded(ray, EPS1, tMax, filter);
+            CountRay(RayType::Shadow);
+            return occluded;
+        }
+
+        AccelStatistics const & GetStatistics() const {
+            return _structure == AccelerationStructure::KdTree ? _kdTree.GetStatistics() : _bvh.GetStatistics();
+        }
+
+        // rays, traversal work and paths since the last reset; the tracing functions count into it through the const reference.
+        RayStatistics const & GetRayStatistics() const { return _rayStatistics; }
+        void                  ResetRayStatistics() { _rayStatistics.Reset(); }
+
+        // number of Intersect(..) and Occluded(..) calls since the last reset, used to report ray throughput.
+        std::uint64_t GetRayCount() const { return _rayStatistics.Gather().GetRays(); }
+
+    private:
+        void CountRay(RayType const type) const {
+            // what the thread traversed since its previous ray, which leaves the counters to other readers, e.g. CostMap.
+            thread_local TraversalCounters counted;
+            TraversalCounters const &      counters = GetTraversalCounters();
+            _rayStatistics.AddRay(type, counters.NodesVisited - counted.NodesVisited, counters.TrianglesTested - counted.TrianglesTested);
+            counted = counters;
+        }
+
+        AccelerationStructure _structure = AccelerationStructure::BVH;
+        TwoLevelBVH           _bvh;
+        KdTree                _kdTree;
+        RenderScene           _renderScene;
+        RayStatistics         _rayStatistics;
+    };
 
     float halton(int index, int base);
 
     glm::vec3 RayTrace(const RayIntersector & intersector, Ray ray, int maxDepth, bool enableShadow);
 
-    glm::vec3 PathTrace(const RayIntersector & intersector, Ray ray, int maxDepth, int samples, int seed);
+    // sampler supplies every random number of the path, camera jitter excluded.
+    glm::vec3 PathTrace(const RayIntersector & intersector, Ray ray, int maxDepth, Sampler & sampler);
 
 } // namespace VCX::Labs::Rendering
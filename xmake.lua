@@ -83,3 +83,49 @@ target("finalproject")
     after_install(function (target)
         os.cp("src/VCX/Labs/Final_Project/shaders/*", path.join(target:installdir(), "bin", "assets", "shaders"))
     end)
+
+-- CPU parts of the engine and the final project: no glad, glfw or imgui, so what links only this builds and runs without a display.
+target("render-core")
+    set_kind("static")
+    add_deps("assets")
+    add_packages("glm"          , { public = true })
+    add_packages("spdlog"       , { public = true })
+    add_packages("stb"          , { public = true })
+    add_packages("fmt"          , { public = true })
+    add_packages("tinyobjloader", { public = true })
+    add_packages("yaml-cpp"     , { public = true })
+
+    add_includedirs("src/3rdparty", { public = true })
+    add_includedirs("src/VCX"     , { public = true })
+    add_files      ("src/3rdparty/stb_image.cpp")
+    add_files      ("src/3rdparty/tiny_obj_loader.cpp")
+    add_files      ("src/VCX/Engine/Async.cpp")
+    add_files      ("src/VCX/Engine/loader.cpp")
+    add_files      ("src/VCX/Engine/Scene.cpp")
+    add_files      ("src/VCX/Engine/SurfaceMesh.cpp")
+    add_files      ("src/VCX/Engine/ThreadPool.cpp")
+    add_files      ("src/VCX/Engine/Trace.cpp")
+    add_files      ("src/VCX/Labs/Common/ImageRGB.cpp")
+    add_files      ("src/VCX/Labs/Common/RenderScheduler.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/Benchmark.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/BVH.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/CostMap.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/KdTree.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/RayStatistics.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/RenderScene.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/Sampler.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/TileRenderer.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/WideBVH.cpp")
+    add_files      ("src/VCX/Labs/Final_Project/tasks.cpp")
+
+-- headless renderer for machines without a display.
+target("render-cli")
+    set_kind("binary")
+    add_deps("render-core")
+    add_files("src/VCX/Labs/Final_Project/cli/render.cpp")
+
+-- microbenchmarks of the kernels in tasks.cpp, meaningful in release mode only.
+target("render-bench")
+    set_kind("binary")
+    add_deps("render-core")
+    add_files("src/VCX/Labs/Final_Project/cli/bench.cpp")